@@ -1,6 +1,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -134,8 +135,17 @@ void submitFrame(VkDevice device, VkQueue queue, VkCommandBuffer cmd_buffer, Fra
 }
 
 
-int main() {
+int main(int argc, char **argv) {
   GLFWwindow *window;
+  int flags = NVG_ANTIALIAS | NVG_STENCIL_STROKES;
+  // --coverage: compare NVG_COVERAGE_FILLS against the stencil fills
+  // --text: NVG_INSTANCED_TEXT
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--coverage") == 0)
+      flags |= NVG_COVERAGE_FILLS;
+    if (strcmp(argv[i], "--text") == 0)
+      flags |= NVG_INSTANCED_TEXT;
+  }
 
   if (!glfwInit()) {
     printf("Failed to init GLFW.");
@@ -194,7 +204,7 @@ int main() {
   create_info.renderpass = fb.render_pass;
   create_info.cmdBuffer = cmd_buffer;
 
-  NVGcontext *vg = nvgCreateVk(create_info, NVG_ANTIALIAS | NVG_STENCIL_STROKES);
+  NVGcontext *vg = nvgCreateVk(create_info, flags);
 
   DemoData data;
   if (loadDemoData(vg, &data) == -1)
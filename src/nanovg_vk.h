@@ -11,15 +11,82 @@ enum NVGcreateFlags {
   NVG_STENCIL_STROKES = 1 << 1,
   // Flag indicating that additional debug checks are done.
   NVG_DEBUG = 1 << 2,
+  // Flag indicating that vertices are uploaded as 16 bit fixed point (8 bytes instead of 16), quantized per draw call.
+  // Positions keep about 1/32767 of the call's extent of precision.
+  NVG_PACKED_VERTICES = 1 << 3,
+  // Flag indicating that calls are reordered at flush to group the ones sharing pipeline and image.
+  // Calls only move past calls they do not overlap, so the result looks the same.
+  NVG_REORDER_CALLS = 1 << 4,
+  // Flag indicating that opaque convex fills are drawn first, front to back with depth writes, so that what they cover
+  // is not shaded again. Every call is depth tested against them. The render pass needs a depth attachment cleared to 1.0.
+  NVG_DEPTH_OVERDRAW = 1 << 5,
+  // Flag indicating that concave fills are drawn in a single pass instead of stencil-then-cover: their edges are
+  // binned into bands of rows in a storage buffer and the fragment shader computes the exact coverage of each pixel.
+  // Fills crossing a band with more than VKNVG_COVERAGE_MAX_BAND_EDGES edges, whose pixels would loop over all of them,
+  // keep stencil-then-cover.
+  NVG_COVERAGE_FILLS = 1 << 6,
+  // Flag indicating that topology, cull mode, depth and stencil state are set with VK_EXT_extended_dynamic_state
+  // (or Vulkan 1.3) instead of being baked into pipelines, which then only differ by shader variant. When
+  // VK_EXT_extended_dynamic_state3 is enabled as well (colorBlendEnable, colorBlendEquation and colorWriteMask
+  // features), blending is dynamic too. Ignored if the device does not expose the commands.
+  NVG_DYNAMIC_STATE = 1 << 7,
+  // Flag indicating that every texture lives in one descriptor array (Vulkan 1.2 or VK_EXT_descriptor_indexing), so
+  // calls bind a single descriptor set per frame and differing images no longer split batches. The device must be
+  // created with the runtimeDescriptorArray, descriptorBindingPartiallyBound, descriptorBindingSampledImageUpdateAfterBind
+  // and descriptorBindingUpdateUnusedWhilePending features. At most VKNVG_MAX_BINDLESS_TEXTURES images can exist.
+  NVG_BINDLESS_TEXTURES = 1 << 8,
+  // Flag indicating that text is drawn as one instance per glyph (36 bytes instead of 6 vertices), expanded into a
+  // quad by the vertex shader. Consecutive text calls with the same font atlas, scissor and blending share one draw.
+  // Only axis-aligned glyphs take this path, rotated or skewed text is drawn as triangles.
+  NVG_INSTANCED_TEXT = 1 << 9,
 };
 
+// Image flags of this backend, next to NVGimageFlags.
+enum NVGvkImageFlags {
+  // The image is a signed distance field: one channel, 0.5 on the edge, decreasing outside. It is drawn as an
+  // antialiased shape at any scale, tinted like an alpha texture. nanovg's own text still uses the coverage atlas of
+  // fontstash, rasterized per size; distance field glyphs are images the application makes and draws itself.
+  NVG_IMAGE_SDF = 1 << 16,
+  // Same with a multi-channel distance field (as made by msdfgen), the distance is the median of red, green and blue.
+  NVG_IMAGE_MSDF = 1 << 17,
+};
+
+// Texels spanned by the distance values 0 to 1 of NVG_IMAGE_SDF and NVG_IMAGE_MSDF images, unless given to
+// nvgVkCreateImageSDF (msdfgen's pxRange, 255 / pixel_dist_scale of stb_truetype's SDF).
+#ifndef VKNVG_DEFAULT_SDF_RANGE
+#define VKNVG_DEFAULT_SDF_RANGE 4.0f
+#endif
+
+#ifndef VKNVG_MAX_BINDLESS_TEXTURES
+#define VKNVG_MAX_BINDLESS_TEXTURES 4096
+#endif
+
+// Device level resources (shader modules, layouts, pipelines and samplers) that can be shared by several contexts.
+typedef struct VKNVGdeviceCache VKNVGdeviceCache;
+
 typedef struct VKNVGCreateInfo {
   VkPhysicalDevice gpu;
   VkDevice device;
-  VkRenderPass renderpass;
-  VkCommandBuffer cmdBuffer;
+  VkRenderPass renderpass; //Can be null to draw inside vkCmdBeginRendering (dynamicRendering feature), see colorFormat
+  VkCommandBuffer cmdBuffer; //Draws are recorded here. The scissor is changed for scissored calls and then left covering
+                             //the whole view (viewOffset, window size * devicePixelRatio of nvgBeginFrame) after nvgEndFrame
 
   const VkAllocationCallbacks *allocator; //Allocator for vulkan. can be null
+  VKNVGdeviceCache *deviceCache;          //Shared device cache. can be null (the context creates its own)
+  VkQueue queue;                          //Queue for uploads to device local memory. can be null (host visible memory is used instead)
+  uint32_t queueFamilyIndex;              //Family of queue
+  VkSampleCountFlagBits sampleCount;      //Samples of renderpass' color attachment. 0 means 1. Above 1, NVG_ANTIALIAS is ignored
+                                          //for it: no fringes are generated or drawn. Offscreen framebuffers stay single
+                                          //sampled and keep NVG_ANTIALIAS while bound
+  VkFormat colorFormat;                   //Without renderpass: attachment formats of the dynamic rendering pipelines are compiled for.
+  VkFormat depthStencilFormat;            //Pipelines are shared by every target with the same formats
+  uint32_t framesInFlight;                //Frames the GPU may still be executing while the next one is recorded, e.g. 2 when
+                                          //frame N - 2 is waited for before recording frame N (see nvgVkEndFrame). Per frame
+                                          //buffers are kept in a ring of that many frames, and images, buffers and display lists
+                                          //deleted during a frame are destroyed that many frames later.
+                                          //0 destroys them at once (the queue must be idle)
+  VkOffset2D viewOffset;                  //Pixel origin of the caller's viewport, where the view starts in the render target.
+                                          //Framebuffers of nvgVkBindFramebuffer are drawn at 0,0
 } VKNVGCreateInfo;
 #ifdef __cplusplus
 extern "C" {
@@ -27,17 +94,117 @@ extern "C" {
 NVGcontext *nvgCreateVk(VKNVGCreateInfo createInfo, int flags);
 void nvgDeleteVk(NVGcontext *ctx);
 
+// Ends the frame recorded into createInfo.cmdBuffer, after its last nvgEndFrame: call it once per submission. The
+// buffers of a frame are rewritten createInfo.framesInFlight frames later and what it released is destroyed then.
+// Until it is first called, every nvgEndFrame ends a frame.
+void nvgVkEndFrame(NVGcontext *ctx);
+
+// Creates a cache that can be passed to any number of contexts through VKNVGCreateInfo::deviceCache.
+// Pipelines are looked up and created under a lock, so contexts may live on different threads.
+// The cache is reference counted: it is released once it has been deleted and every context using it is gone.
+VKNVGdeviceCache *nvgVkCreateDeviceCache(VkPhysicalDevice gpu, VkDevice device, const VkAllocationCallbacks *allocator);
+void nvgVkDeleteDeviceCache(VKNVGdeviceCache *cache);
+
+// Offscreen render target, the Vulkan counterpart of nanovg_gl_utils' NVGLUframebuffer.
+// The color attachment is a regular nanovg image (see 'image') that can be used with nvgImagePattern.
+typedef struct VKNVGframebuffer {
+  NVGcontext *ctx;
+  VkRenderPass renderpass;
+  VkFramebuffer framebuffer;
+  VkImage stencilImage;
+  VkDeviceMemory stencilMem;
+  VkImageView stencilView;
+  int image;
+  int width;
+  int height;
+} VKNVGframebuffer;
+
+// Framebuffers with the same formats share a render pass of the device cache, and so their pipelines. The image is
+// cleared to transparent black through createInfo.queue; without one it must be drawn into before it is sampled.
+VKNVGframebuffer *nvgVkCreateFramebuffer(NVGcontext *ctx, int w, int h, int imageFlags);
+// Ends the render pass of the previously bound framebuffer (if any) and, when fb is not null, begins fb's render pass
+// on createInfo.cmdBuffer, clearing it to transparent black. Must be called outside of any other render pass.
+// Pass null to return to createInfo.renderpass; the caller then begins its own pass again. Framebuffers are single
+// sampled: NVG_ANTIALIAS fringes are drawn into them even when createInfo.sampleCount leaves them out of the main pass.
+// Each nvgBeginFrame/nvgEndFrame drawn into a framebuffer gets buffers of its own, kept until its frame has retired
+// like those of the main pass, so several passes can be recorded into one command buffer. Without nvgVkEndFrame,
+// the frame ends with the next nvgEndFrame drawn outside of any framebuffer.
+void nvgVkBindFramebuffer(NVGcontext *ctx, VKNVGframebuffer *fb);
+void nvgVkDeleteFramebuffer(VKNVGframebuffer *fb);
+
+// Immutable, GPU resident copy of a range of draw calls (vertices, uniforms and the call table).
+typedef struct VKNVGdisplayList VKNVGdisplayList;
+
+// Calls issued between nvgVkBeginDisplayList and nvgVkEndDisplayList are captured into the list instead of being drawn.
+// Both must be called within the same frame. Uploads go through createInfo.queue when set, which must not be used
+// by other threads meanwhile. Images referenced by the captured calls (including the font atlas) must outlive the list.
+void nvgVkBeginDisplayList(NVGcontext *ctx);
+// Returns null when the list cannot be allocated or uploaded.
+VKNVGdisplayList *nvgVkEndDisplayList(NVGcontext *ctx);
+// Replays the list in the current frame. xform (6 floats, as nvgCurrentTransform, can be null) is applied on top
+// of the transform the list was captured with, and alpha multiplies its colors. Paints and scissors follow xform,
+// antialiasing fringes are scaled with it.
+void nvgVkDrawDisplayList(NVGcontext *ctx, VKNVGdisplayList *list, const float *xform, float alpha);
+// Without createInfo.framesInFlight, the list must not be used by any frame still in flight.
+void nvgVkDeleteDisplayList(NVGcontext *ctx, VKNVGdisplayList *list);
+
+// Most bytes the per frame storage (calls, paths, vertices, uniforms) held in a frame so far. The storage is kept at
+// that size after each flush, so frames that stay below it make no heap allocations.
+size_t nvgVkFrameMemoryHighWater(NVGcontext *ctx);
+
+// Creates a distance field image (see NVG_IMAGE_SDF), one byte per texel, or RGBA with NVG_IMAGE_MSDF in imageFlags.
+// range is the distance in texels between the values 0 and 1. Returns a nanovg image, 0 on failure.
+int nvgVkCreateImageSDF(NVGcontext *ctx, int w, int h, int imageFlags, float range, const unsigned char *data);
+
+// Creates an image from pre-compressed blocks (BCn, ETC2, ASTC, ... e.g. the levels of a KTX2 file), uploaded through
+// createInfo.queue. levels[i] holds sizes[i] bytes of mip level i, which is max(w >> i, 1) x max(h >> i, 1) texels.
+// Images with more than one level are sampled with mipmapping. BC4 and EAC R11 images are drawn as alpha textures.
+// Returns a nanovg image, 0 without an upload queue or when the device cannot sample the format.
+int nvgVkCreateImageCompressed(NVGcontext *ctx, VkFormat format, int w, int h, int mipLevels, int imageFlags,
+                               const void *const *levels, const size_t *sizes);
+
+// Creates an RGBA image sourced from the caller's memory (w * h * 4 bytes, rows tightly packed) without copying it
+// on the CPU, through VK_EXT_external_memory_host, which the device must have enabled. data and size must be multiples
+// of minImportedHostPointerAlignment, and the memory must stay valid until the image is deleted and its frames are done.
+// When the device can import it into a linear image laid out like data, the image is sampled straight from that memory.
+// Otherwise the memory backs a staging buffer, copied into a device local image through createInfo.queue: at creation,
+// waiting for the copy, and on each nvgUpdateImage, without waiting, so frames drawing the image must be submitted to
+// createInfo.queue too. nvgUpdateImage with data itself only makes the new contents visible, with another pointer it
+// copies into data first.
+// The memory must not be written while frames in flight read the image: alternate images to stream video.
+// Returns a nanovg image, 0 when the memory cannot be imported or on errors.
+int nvgVkCreateImageFromHostMemory(NVGcontext *ctx, int w, int h, int imageFlags, void *data, VkDeviceSize size);
+
+// Called for the evicted images drawn or updated again since the last flush, at the start of the next one (nvgEndFrame),
+// before the frame is recorded. Their storage has been recreated with undefined contents, which the callback fills
+// with nvgUpdateImage. When the storage cannot be recreated, the draws with the image are skipped and older images are
+// evicted to make room for the next attempt.
+typedef void (*VKNVGrestoreImageFn)(void *userData, int image);
+
+// Caps the memory of resident images at budget bytes. At the end of each frame, the RGBA images of nvgCreateImage*
+// that were drawn least recently are evicted until the images fit; images still used by frames in flight, the font
+// atlas, framebuffers and compressed images are never evicted. budget 0 follows VK_EXT_memory_budget: 90% of the
+// heap's budget, less what others use of it, and no limit when the device lacks it. A null restore disables eviction.
+void nvgVkSetTextureBudget(NVGcontext *ctx, VkDeviceSize budget, VKNVGrestoreImageFn restore, void *userData);
+
 #ifdef __cplusplus
 }
 #endif
 
 #ifdef NANOVG_VULKAN_IMPLEMENTATION
 
+#include <float.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VKNVG_SSE2
+#endif
+
 #if !defined(__cplusplus) || defined(NANOVG_VK_NO_nullptrPTR)
 #define nullptr NULL
 #endif
@@ -50,6 +217,25 @@ void nvgDeleteVk(NVGcontext *ctx);
     }                            \
   }
 
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+typedef SRWLOCK VKNVGmutex;
+static void vknvg_mutexInit(VKNVGmutex *m) { InitializeSRWLock(m); }
+static void vknvg_mutexDestroy(VKNVGmutex *m) { (void)m; }
+static void vknvg_mutexLock(VKNVGmutex *m) { AcquireSRWLockExclusive(m); }
+static void vknvg_mutexUnlock(VKNVGmutex *m) { ReleaseSRWLockExclusive(m); }
+#else
+#include <pthread.h>
+typedef pthread_mutex_t VKNVGmutex;
+static void vknvg_mutexInit(VKNVGmutex *m) { pthread_mutex_init(m, nullptr); }
+static void vknvg_mutexDestroy(VKNVGmutex *m) { pthread_mutex_destroy(m); }
+static void vknvg_mutexLock(VKNVGmutex *m) { pthread_mutex_lock(m); }
+static void vknvg_mutexUnlock(VKNVGmutex *m) { pthread_mutex_unlock(m); }
+#endif
+
 enum VKNVGshaderType {
   NSVG_SHADER_FILLGRAD,
   NSVG_SHADER_FILLIMG,
@@ -68,25 +254,70 @@ typedef struct VKNVGtexture {
   int32_t width, height;
   int type; //enum NVGtexture
   int flags;
+  float sdfRange; // NVG_IMAGE_SDF, NVG_IMAGE_MSDF
+
+  // nvgVkSetTextureBudget
+  VkDeviceSize memSize;
+  uint64_t lastUsed; // VKNVGcontext::frameIndex of the last frame drawing it
+  bool evictable;
+  bool evicted; // image, view and memory are released until it is drawn again
+  bool restorePending; // recreated after eviction, VKNVGcontext::restoreImage runs at the next flush
+  bool mappable; //linear host visible image that vknvg_UpdateTexture can write to
+  bool premultiply; // straight alpha data, premultiplied by vknvg_UpdateTexture
+
+  // nvgVkCreateImageFromHostMemory
+  void *hostPointer;
+  VkBuffer hostBuffer; // null when the image is bound to the imported memory itself
+  VkDeviceMemory hostMem;
+
+  int id;       // handle of the live texture in this slot, 0 while the slot is free
+  int nextFree; // slot + 1 of the next free slot, 0 at the end of the free-list
+  int generation;
 } VKNVGtexture;
 
+// texture handles are (generation << VKNVG_TEXTURE_SLOT_BITS) | (slot + 1), so a stale handle does not match a reused
+// slot until its generation wraps: 32768 reuses of that slot, which the FIFO free-list spreads over all free slots
+#define VKNVG_TEXTURE_SLOT_BITS 16
+#define VKNVG_TEXTURE_SLOT_MASK ((1 << VKNVG_TEXTURE_SLOT_BITS) - 1)
+#define VKNVG_TEXTURE_GENERATION_MASK ((1 << (31 - VKNVG_TEXTURE_SLOT_BITS)) - 1)
+#define VKNVG_TEXTURE_CHUNK_SIZE 64
+
 enum VKNVGcallType {
   VKNVG_NONE = 0,
   VKNVG_FILL,
   VKNVG_CONVEXFILL,
   VKNVG_STROKE,
   VKNVG_TRIANGLES,
+  VKNVG_DISPLAYLIST,
+  VKNVG_COVERAGEFILL,
+  VKNVG_TEXT,
 };
 
 typedef struct VKNVGcall {
   int type;
   int image;
+  int shaderType; //enum VKNVGshaderType of the paint, selects the pipeline's shader variant
+  int texType;
+  // NVG_PACKED_VERTICES: scale and bias from the packed vertices back to positions and tcoords
+  float posDequant[4];
+  float uvDequant[4];
   int pathOffset;
   int pathCount;
   int triangleOffset;
   int triangleCount;
+  int glyphOffset; // VKNVG_TEXT instances
+  int glyphCount;
   int uniformOffset;
   NVGcompositeOperationState compositOperation;
+  // conservative pixel rect of the scissor, set with vkCmdSetScissor when scissored
+  bool scissored;
+  VkRect2D scissorRect;
+  float bounds[4]; // of everything the call draws, in canvas space (minx, miny, maxx, maxy)
+  bool opaque;      // NVG_DEPTH_OVERDRAW: the interior is drawn in the opaque pass, only the fringes are left
+  // VKNVG_DISPLAYLIST only
+  VKNVGdisplayList *displayList;
+  float xform[6];
+  float alpha;
 } VKNVGcall;
 
 typedef struct VKNVGpath {
@@ -110,23 +341,130 @@ typedef struct VKNVGfragUniforms {
   float strokeThr;
   int texType;
   int type;
+  float coverage[4]; // NVG_COVERAGE_FILLS: first band record, band count, top and height of the bands in pixels
+  int texIndex;      // NVG_BINDLESS_TEXTURES: element of the texture array, the texture's slot
+  float sdfRange;    // texType 2 and 3, see VKNVGtexture::sdfRange
 } VKNVGfragUniforms;
 
+// matches the push_constant block of the shaders
+typedef struct VKNVGpushConstants {
+  float xform[6];
+  float alpha;
+  float depth; // NVG_DEPTH_OVERDRAW: of the call being drawn, from its painter's order
+  float posDequant[4];
+  float uvDequant[4];
+} VKNVGpushConstants;
+
+// NVG_INSTANCED_TEXT instance, the input of text.vert
+typedef struct VKNVGglyph {
+  float rect[4]; // x0, y0, x1, y1
+  float uv[4];   // s0, t0, s1, t1
+  unsigned char color[4]; // premultiplied rgba, the call's innerCol is white
+} VKNVGglyph;
+
+// NVG_PACKED_VERTICES layout: snorm positions and unorm tcoords, relative to the ranges of their call
+typedef struct VKNVGpackedVertex {
+  int16_t x, y;
+  uint16_t u, v;
+} VKNVGpackedVertex;
+
 typedef struct VKNVGBuffer {
   VkBuffer buffer;
   VkDeviceMemory mem;
   VkDeviceSize size;
 } VKNVGBuffer;
 
+// Per frame storage that grows in chunks, so elements never move once handed out. Elements are addressed by their
+// index in the frame and an allocation never straddles chunks. A frame that needed more than one chunk is coalesced
+// into a single chunk of the high-water size when the arena is reset, so steady state frames make no heap operations.
+typedef struct VKNVGarenaChunk {
+  unsigned char *data;
+  int base;     // index of the first element
+  int capacity; // in elements
+} VKNVGarenaChunk;
+
+typedef struct VKNVGarena {
+  VKNVGarenaChunk *chunks;
+  int nchunks;
+  int cchunks;
+  int elemSize;
+  int minCapacity;
+  int count;     // elements handed out this frame
+  int highWater; // most elements handed out in a frame
+} VKNVGarena;
+
+// Vulkan objects released while frames may still use them, destroyed once createInfo.framesInFlight frames later.
+typedef struct VKNVGgarbage {
+  uint64_t frame; // VKNVGcontext::frameIndex when released
+  VkImage image;
+  VkImageView view;
+  VkDeviceMemory mem;
+  VkBuffer buffer;
+  VkDescriptorPool descPool;
+  VkFramebuffer framebuffer;
+  int textureSlot; // slot + 1 of a deleted texture, reused only once its frames are done
+} VKNVGgarbage;
+
+// One shot upload submitted without waiting, see vknvg_submitUpload.
+typedef struct VKNVGupload {
+  VkCommandBuffer cmdBuffer;
+  VkFence fence;
+} VKNVGupload;
+
+struct VKNVGdisplayList {
+  VKNVGcall *calls;
+  int ncalls;
+  VKNVGpath *paths;
+  int npaths;
+  VKNVGBuffer vertexBuffer;
+  VKNVGBuffer fragUniformBuffer;
+  VKNVGBuffer glyphBuffer;
+  float bounds[4]; // union of the calls' bounds
+};
+
+// Buffers and descriptor pool of one flush, rewritten only once the frame that recorded it has retired.
+typedef struct VKNVGflushResources {
+  VKNVGBuffer vertexBuffer;
+  VKNVGBuffer vertUniformBuffer;
+  VKNVGBuffer fragUniformBuffer;
+  VKNVGBuffer coverageBuffer; // always exists, every descriptor set refers to it
+  VKNVGBuffer glyphBuffer;
+  VkDescriptorPool descPool;
+  int cdescPool;
+} VKNVGflushResources;
+
+// The flushes of one frame of the ring, see createInfo.framesInFlight.
+typedef struct VKNVGframeResources {
+  VKNVGflushResources *flushes;
+  int nflushes; // used by the frame
+  int cflushes;
+} VKNVGframeResources;
+
 enum VKNVGstencilType {
   VKNVG_STENCIL_NONE = 0,
   VKNVG_STENCIL_FILL,
 };
 typedef struct VKNVGCreatePipelineKey {
+  VkRenderPass renderpass;
+  // dynamic rendering, without renderpass
+  VkFormat colorFormat;
+  VkFormat depthStencilFormat;
   bool stencilFill;
   bool stencilTest;
+  bool stencilClear;
   bool edgeAA;
   bool edgeAAShader;
+  bool packedVertices;
+  bool depthTest;
+  bool depthWrite;
+  bool coverage;
+  bool dynamicState; // NVG_DYNAMIC_STATE: topology, cull mode, depth and stencil state are left out of the pipeline
+  bool dynamicBlend; // blend enable, equation and write mask too
+  bool bindless;     // NVG_BINDLESS_TEXTURES: fill.frag built with BINDLESS and the bindless layout
+  bool text;         // NVG_INSTANCED_TEXT: text.vert with VKNVGglyph instances
+  VkSampleCountFlagBits sampleCount;
+  int shaderType;
+  int texType;
   VkPrimitiveTopology topology;
   NVGcompositeOperationState compositOperation;
 } VKNVGCreatePipelineKey;
@@ -136,11 +474,63 @@ typedef struct VKNVGPipeline {
   VkPipeline pipeline;
 } VKNVGPipeline;
 
-typedef struct VKNVGDepthSimplePipeline {
-  VkPipeline pipeline;
+// Index into VKNVGdeviceCache::samplers, built from NVG_IMAGE_NEAREST, NVG_IMAGE_REPEATX, NVG_IMAGE_REPEATY and
+// NVG_IMAGE_GENERATE_MIPMAPS.
+enum VKNVGsamplerBits {
+  VKNVG_SAMPLER_NEAREST = 1 << 0,
+  VKNVG_SAMPLER_REPEATX = 1 << 1,
+  VKNVG_SAMPLER_REPEATY = 1 << 2,
+  VKNVG_SAMPLER_MIPMAP = 1 << 3, // NVG_IMAGE_GENERATE_MIPMAPS
+  VKNVG_SAMPLER_COUNT = 1 << 4,
+};
+
+#define VKNVG_MAX_FRAMEBUFFER_PASSES 8
+
+// Render pass of the framebuffers with these formats.
+typedef struct VKNVGframebufferPass {
+  VkFormat colorFormat;
+  VkFormat stencilFormat;
+  VkRenderPass renderpass;
+} VKNVGframebufferPass;
+
+struct VKNVGdeviceCache {
+  VkPhysicalDevice gpu;
+  VkDevice device;
+  const VkAllocationCallbacks *allocator;
+
+  VKNVGmutex mutex;
+  int refCount;
+
+  VkShaderModule fillFragShader;
+  VkShaderModule fillVertShader;
+  VkShaderModule stencilFragShader;
+  VkShaderModule textVertShader;
+
   VkDescriptorSetLayout descLayout;
   VkPipelineLayout pipelineLayout;
-} VKNVGDepthSimplePipeline;
+  // stencil only passes (NSVG_SHADER_SIMPLE) only read the view size
+  VkDescriptorSetLayout stencilDescLayout;
+  VkPipelineLayout stencilPipelineLayout;
+
+  // NVG_BINDLESS_TEXTURES, created by the first context using it (guarded by mutex): set 0 with the uniforms at a
+  // dynamic offset, set 1 with the texture array
+  VkShaderModule fillBindlessFragShader;
+  VkDescriptorSetLayout bindlessDescLayout;
+  VkDescriptorSetLayout textureDescLayout;
+  VkPipelineLayout bindlessPipelineLayout;
+
+  // guarded by mutex
+  VKNVGPipeline *pipelines;
+  int cpipelines;
+  int npipelines;
+
+  // nvgVkCreateFramebuffer, guarded by mutex: framebuffers with the same formats share a render pass, and so their
+  // pipelines, which live as long as the cache
+  VKNVGframebufferPass framebufferPasses[VKNVG_MAX_FRAMEBUFFER_PASSES];
+  int nframebufferPasses;
+
+  VkSampler samplers[VKNVG_SAMPLER_COUNT];
+};
 
 typedef struct VKNVGcontext {
   VKNVGCreateInfo createInfo;
@@ -150,50 +540,206 @@ typedef struct VKNVGcontext {
 
   int fragSize;
   int flags;
+  bool antialias; // NVG_ANTIALIAS as requested, kept in flags only while the target is single sampled
 
   //own resources
-  VKNVGtexture *textures;
-  int ntextures;
-  int ctextures;
-
-  VkDescriptorSetLayout descLayout;
-  VkPipelineLayout pipelineLayout;
-
-  VKNVGPipeline *pipelines;
-  int cpipelines;
-  int npipelines;
+  VKNVGtexture **textureChunks; // fixed size chunks, so texture pointers stay valid as the pool grows
+  int ntextureChunks;
+  int ctextureChunks;
+  int ntextures;       // slots handed out so far, live or free
+  int freeTextures;    // slot + 1 of the first free slot, 0 if none
+  int lastFreeTexture; // slot + 1 of the last free slot, where freed slots are appended
+
+  // nvgVkSetTextureBudget
+  VkDeviceSize textureMemory; // of the resident textures
+  VkDeviceSize textureBudget; // 0: from VK_EXT_memory_budget
+  uint32_t textureHeap;       // of the evictable textures
+  bool memoryBudget;          // the gpu supports VK_EXT_memory_budget
+  VKNVGrestoreImageFn restoreImage;
+  void *restoreUserData;
+  int nrestores; // textures with restorePending
+
+  //shared resources
+  VKNVGdeviceCache *cache;
 
   float view[2];
+  float devicePixelRatio;
+  VkRect2D viewScissor;    // the whole view in pixels of the target, the scissor the caller is expected to have set
+  VkRect2D currentScissor; // last scissor set while recording
+  bool replaying;          // inside a display list, whose scissor rects do not follow its transform
 
-  // Per frame buffers
-  VKNVGcall *calls;
-  int ccalls;
-  int ncalls;
-  VKNVGpath *paths;
-  int cpaths;
-  int npaths;
-  struct NVGvertex *verts;
-  int cverts;
-  int nverts;
-
-  VkDescriptorPool descPool;
-  int cdescPool;
-
-  unsigned char *uniforms;
-  int cuniforms;
-  int nuniforms;
-  VKNVGBuffer vertexBuffer;
-  VKNVGBuffer vertUniformBuffer;
-  VKNVGBuffer fragUniformBuffer;
-  VKNVGPipeline *currentPipeline;
+  // render pass the pipelines are bound for: createInfo.renderpass or the bound framebuffer's
+  VkRenderPass renderpass;
+  VKNVGframebuffer *boundFramebuffer;
 
-  VkShaderModule fillFragShader;
-  VkShaderModule fillFragShaderAA;
-  VkShaderModule fillVertShader;
+  // Per frame buffers
+  VKNVGarena calls;       // VKNVGcall
+  VKNVGarena paths;       // VKNVGpath
+  VKNVGarena verts;       // NVGvertex
+  VKNVGarena packedVerts; // NVG_PACKED_VERTICES: VKNVGpackedVertex, what is uploaded, same indices as verts
+  VkDeviceSize vertexSize; // of the uploaded vertices
+
+  VKNVGarena uniforms; // fragSize bytes each
+  VkPipeline currentPipeline;
+
+  VKNVGframeResources *frames; // ring of max(framesInFlight, 1) frames, indexed by frameIndex
+  int nframes;
+  VKNVGflushResources *flush; // of the flush being recorded
+  bool explicitFrames;        // nvgVkEndFrame has been called, flushes no longer end frames
+
+  // what the draw functions read from: the frame's data or a display list being replayed
+  VKNVGpath *drawPaths; // null for the frame's own paths
+  VkBuffer drawVertexBuffer;
+  VkBuffer drawFragUniformBuffer;
+  VkBuffer drawGlyphBuffer;
+  VkDescriptorSet stencilDescSet; // shared by the stencil only passes of a frame
+  VkDescriptorSet drawDescSet;    // NVG_BINDLESS_TEXTURES: set 0 of drawFragUniformBuffer
+
+  // NVG_BINDLESS_TEXTURES: one descriptor per texture slot
+  VkDescriptorPool textureDescPool;
+  VkDescriptorSet textureDescSet;
+  int dummyImage; // 1x1 white, bound where no image is sampled
+
+  // NVG_INSTANCED_TEXT
+  VKNVGarena glyphs; // VKNVGglyph
+
+  // NVG_COVERAGE_FILLS band records and edges, 4 floats each
+  VKNVGarena coverage;
+
+  // display list capture, marks where the captured range starts
+  bool capturing;
+  int captureCall;
+  int capturePath;
+  int captureVert;
+  int captureUniform;
+  int captureGlyph;
+
+  VkCommandPool uploadCmdPool;
+  VKNVGupload *uploads; // submitted, still pending
+  int nuploads;
+  int cuploads;
+
+  // deferred destruction, see createInfo.framesInFlight
+  uint64_t frameIndex; // number of ended frames
+  VKNVGgarbage *garbage;
+  int cgarbage;
+  int ngarbage;
+
+  // NVG_REORDER_CALLS scratch space
+  int *callOrder;
+  int *reorderLinks;
+  int creorder;
+
+  // NVG_DYNAMIC_STATE, cleared when the commands are missing
+  bool dynamicState;
+  bool dynamicBlend;
+  bool dynamicStateSet; // dynamicStateKey has been applied to the command buffer
+  VKNVGCreatePipelineKey dynamicStateKey;
+  PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology;
+  PFN_vkCmdSetCullModeEXT cmdSetCullMode;
+  PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable;
+  PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable;
+  PFN_vkCmdSetStencilTestEnableEXT cmdSetStencilTestEnable;
+  PFN_vkCmdSetStencilOpEXT cmdSetStencilOp;
+#ifdef VK_EXT_extended_dynamic_state3
+  PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable;
+  PFN_vkCmdSetColorBlendEquationEXT cmdSetColorBlendEquation;
+  PFN_vkCmdSetColorWriteMaskEXT cmdSetColorWriteMask;
+#endif
 } VKNVGcontext;
 
 static int vknvg_maxi(int a, int b) { return a > b ? a : b; }
 
+static void vknvg_initArena(VKNVGarena *a, int elemSize, int minCapacity) {
+  memset(a, 0, sizeof(VKNVGarena));
+  a->elemSize = elemSize;
+  a->minCapacity = minCapacity;
+}
+static void vknvg_destroyArena(VKNVGarena *a) {
+  for (int i = 0; i < a->nchunks; i++) {
+    free(a->chunks[i].data);
+  }
+  free(a->chunks);
+  a->chunks = nullptr;
+  a->nchunks = a->cchunks = a->count = 0;
+}
+// Returns the index of n contiguous elements, -1 when out of memory.
+static int vknvg_arenaAlloc(VKNVGarena *a, int n) {
+  VKNVGarenaChunk *chunk = a->nchunks > 0 ? &a->chunks[a->nchunks - 1] : nullptr;
+  if (chunk == nullptr || a->count + n > chunk->base + chunk->capacity) {
+    // the rest of the current chunk is left unused
+    if (a->nchunks + 1 > a->cchunks) {
+      VKNVGarenaChunk *chunks;
+      int cchunks = vknvg_maxi(a->nchunks + 1, 4) + a->cchunks / 2; // 1.5x Overallocate
+      chunks = (VKNVGarenaChunk *)realloc(a->chunks, sizeof(VKNVGarenaChunk) * cchunks);
+      if (chunks == nullptr)
+        return -1;
+      a->chunks = chunks;
+      a->cchunks = cchunks;
+    }
+    // each chunk is at least half of what the frame holds so far, so a frame needs few of them
+    int capacity = vknvg_maxi(n, vknvg_maxi(a->minCapacity, a->count / 2));
+    unsigned char *data = (unsigned char *)malloc((size_t)capacity * a->elemSize);
+    if (data == nullptr)
+      return -1;
+    chunk = &a->chunks[a->nchunks++];
+    chunk->data = data;
+    chunk->base = a->count;
+    chunk->capacity = capacity;
+  }
+  int ret = a->count;
+  a->count += n;
+  return ret;
+}
+static void *vknvg_arenaPtr(const VKNVGarena *a, int i) {
+  if (a->nchunks == 0)
+    return nullptr;
+  const VKNVGarenaChunk *chunk = &a->chunks[a->nchunks - 1];
+  while (chunk->base > i) {
+    chunk--;
+  }
+  return chunk->data + (size_t)(i - chunk->base) * a->elemSize;
+}
+// Copies the elements [first, first + n) into one array.
+static void vknvg_arenaCopy(const VKNVGarena *a, void *dst, int first, int n) {
+  unsigned char *out = (unsigned char *)dst;
+  for (int c = 0; c < a->nchunks && n > 0; c++) {
+    const VKNVGarenaChunk *chunk = &a->chunks[c];
+    int end = c + 1 < a->nchunks ? a->chunks[c + 1].base : a->count;
+    if (first >= end)
+      continue;
+    int m = (first + n < end ? first + n : end) - first;
+    memcpy(out, chunk->data + (size_t)(first - chunk->base) * a->elemSize, (size_t)m * a->elemSize);
+    out += (size_t)m * a->elemSize;
+    first += m;
+    n -= m;
+  }
+}
+// Drops the elements from index count on.
+static void vknvg_arenaRewind(VKNVGarena *a, int count) {
+  a->highWater = vknvg_maxi(a->highWater, a->count);
+  while (a->nchunks > 1 && a->chunks[a->nchunks - 1].base > count) {
+    free(a->chunks[--a->nchunks].data);
+  }
+  a->count = count;
+}
+static void vknvg_arenaReset(VKNVGarena *a) {
+  a->highWater = vknvg_maxi(a->highWater, a->count);
+  a->count = 0;
+  while (a->nchunks > 1) {
+    free(a->chunks[--a->nchunks].data);
+  }
+  if (a->nchunks > 0 && a->chunks[0].capacity < a->highWater) {
+    // keeps the old chunk if the bigger one cannot be had
+    unsigned char *data = (unsigned char *)malloc((size_t)a->highWater * a->elemSize);
+    if (data != nullptr) {
+      free(a->chunks[0].data);
+      a->chunks[0].data = data;
+      a->chunks[0].capacity = a->highWater;
+    }
+  }
+}
+
 static void vknvg_xformToMat3x4(float *m3, float *t) {
   m3[0] = t[0];
   m3[1] = t[1];
@@ -216,87 +762,271 @@ static NVGcolor vknvg_premulColor(NVGcolor c) {
   return c;
 }
 
+static VKNVGtexture *vknvg_textureSlot(VKNVGcontext *vk, int slot) {
+  return &vk->textureChunks[slot / VKNVG_TEXTURE_CHUNK_SIZE][slot % VKNVG_TEXTURE_CHUNK_SIZE];
+}
 static VKNVGtexture *vknvg_findTexture(VKNVGcontext *vk, int id) {
-  if (id > vk->ntextures || id <= 0) {
+  int slot = (id & VKNVG_TEXTURE_SLOT_MASK) - 1;
+  if (id <= 0 || slot < 0 || slot >= vk->ntextures) {
+    return nullptr;
+  }
+  VKNVGtexture *tex = vknvg_textureSlot(vk, slot);
+  if (tex->id != id) { // deleted, or the slot was reused
     return nullptr;
   }
-  VKNVGtexture *tex = vk->textures + id - 1;
   return tex;
 }
 static VKNVGtexture *vknvg_allocTexture(VKNVGcontext *vk) {
-  VKNVGtexture *tex = nullptr;
-  int i;
-
-  for (i = 0; i < vk->ntextures; i++) {
-    if (vk->textures[i].image == VK_NULL_HANDLE) {
-      tex = &vk->textures[i];
-      break;
+  VKNVGtexture *tex;
+  int slot;
+
+  if (vk->freeTextures != 0) {
+    slot = vk->freeTextures - 1;
+    tex = vknvg_textureSlot(vk, slot);
+    vk->freeTextures = tex->nextFree;
+    if (vk->freeTextures == 0)
+      vk->lastFreeTexture = 0;
+  } else {
+    if (vk->ntextures >= VKNVG_TEXTURE_SLOT_MASK) {
+      return nullptr;
     }
-  }
-  if (tex == nullptr) {
-    if (vk->ntextures + 1 > vk->ctextures) {
-      VKNVGtexture *textures;
-      int ctextures = vknvg_maxi(vk->ntextures + 1, 4) + vk->ctextures / 2; // 1.5x Overallocate
-      textures = (VKNVGtexture *)realloc(vk->textures, sizeof(VKNVGtexture) * ctextures);
-      if (textures == nullptr) {
+    if ((vk->flags & NVG_BINDLESS_TEXTURES) && vk->ntextures >= VKNVG_MAX_BINDLESS_TEXTURES) {
+      return nullptr;
+    }
+    if (vk->ntextures == vk->ntextureChunks * VKNVG_TEXTURE_CHUNK_SIZE) {
+      if (vk->ntextureChunks + 1 > vk->ctextureChunks) {
+        VKNVGtexture **chunks;
+        int cchunks = vknvg_maxi(vk->ntextureChunks + 1, 4) + vk->ctextureChunks / 2; // 1.5x Overallocate
+        chunks = (VKNVGtexture **)realloc(vk->textureChunks, sizeof(VKNVGtexture *) * cchunks);
+        if (chunks == nullptr) {
+          return nullptr;
+        }
+        vk->textureChunks = chunks;
+        vk->ctextureChunks = cchunks;
+      }
+      VKNVGtexture *chunk = (VKNVGtexture *)calloc(VKNVG_TEXTURE_CHUNK_SIZE, sizeof(VKNVGtexture));
+      if (chunk == nullptr) {
         return nullptr;
       }
-      vk->textures = textures;
-      vk->ctextures = ctextures;
+      vk->textureChunks[vk->ntextureChunks++] = chunk;
     }
-    tex = &vk->textures[vk->ntextures++];
+    slot = vk->ntextures++;
+    tex = vknvg_textureSlot(vk, slot);
   }
+  int generation = tex->generation;
   memset(tex, 0, sizeof(*tex));
+  tex->generation = generation;
+  tex->id = (generation << VKNVG_TEXTURE_SLOT_BITS) | (slot + 1);
   return tex;
 }
-static int vknvg_textureId(VKNVGcontext *vk, VKNVGtexture *tex) {
-  ptrdiff_t id = tex - vk->textures;
-  if (id < 0 || id > vk->ntextures) {
-    return 0;
+static int vknvg_textureIndex(const VKNVGtexture *tex) {
+  return (tex->id & VKNVG_TEXTURE_SLOT_MASK) - 1;
+}
+// NVG_BINDLESS_TEXTURES: points element slot of the texture array at tex.
+static void vknvg_writeTextureDescriptor(VKNVGcontext *vk, int slot, const VKNVGtexture *tex) {
+  VkDescriptorImageInfo image_info = {tex->sampler, tex->view, tex->imageLayout};
+  VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+  write.dstSet = vk->textureDescSet;
+  write.dstBinding = 0;
+  write.dstArrayElement = slot;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = &image_info;
+  vkUpdateDescriptorSets(vk->createInfo.device, 1, &write, 0, nullptr);
+}
+// Puts the slot of a deleted texture back on the free-list, once no frame in flight can refer to it.
+static void vknvg_freeTextureSlot(VKNVGcontext *vk, int slot) {
+  VKNVGtexture *tex = vknvg_textureSlot(vk, slot);
+  const VKNVGtexture *dummy = vknvg_findTexture(vk, vk->dummyImage);
+  if ((vk->flags & NVG_BINDLESS_TEXTURES) && dummy != nullptr) {
+    // calls still queued with the deleted image read this element
+    vknvg_writeTextureDescriptor(vk, slot, dummy);
   }
-  return (int)id + 1;
+  // reused last, so that its generation wraps as late as possible
+  tex->nextFree = 0;
+  if (vk->lastFreeTexture != 0)
+    vknvg_textureSlot(vk, vk->lastFreeTexture - 1)->nextFree = slot + 1;
+  else
+    vk->freeTextures = slot + 1;
+  vk->lastFreeTexture = slot + 1;
 }
-static int vknvg_deleteTexture(VKNVGcontext *vk, VKNVGtexture *tex) {
+static void vknvg_destroyGarbage(VKNVGcontext *vk, const VKNVGgarbage *g) {
   VkDevice device = vk->createInfo.device;
   const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
-  if (tex) {
-    if (tex->view != VK_NULL_HANDLE) {
-      vkDestroyImageView(device, tex->view, allocator);
-      tex->view = VK_NULL_HANDLE;
-    }
-    if (tex->sampler != VK_NULL_HANDLE) {
-      vkDestroySampler(device, tex->sampler, allocator);
-      tex->sampler = VK_NULL_HANDLE;
+  if (g->framebuffer != VK_NULL_HANDLE)
+    vkDestroyFramebuffer(device, g->framebuffer, allocator);
+  if (g->view != VK_NULL_HANDLE)
+    vkDestroyImageView(device, g->view, allocator);
+  if (g->image != VK_NULL_HANDLE)
+    vkDestroyImage(device, g->image, allocator);
+  if (g->buffer != VK_NULL_HANDLE)
+    vkDestroyBuffer(device, g->buffer, allocator);
+  if (g->mem != VK_NULL_HANDLE)
+    vkFreeMemory(device, g->mem, allocator);
+  if (g->descPool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device, g->descPool, allocator);
+  if (g->textureSlot != 0)
+    vknvg_freeTextureSlot(vk, g->textureSlot - 1);
+}
+
+// Destroys g once the frames that may use it have retired, or right away without createInfo.framesInFlight.
+static void vknvg_release(VKNVGcontext *vk, VKNVGgarbage g) {
+  if (vk->createInfo.framesInFlight == 0) {
+    vknvg_destroyGarbage(vk, &g);
+    return;
+  }
+  if (vk->ngarbage + 1 > vk->cgarbage) {
+    VKNVGgarbage *garbage;
+    int cgarbage = vknvg_maxi(vk->ngarbage + 1, 64) + vk->cgarbage / 2; // 1.5x Overallocate
+    garbage = (VKNVGgarbage *)realloc(vk->garbage, sizeof(VKNVGgarbage) * cgarbage);
+    if (garbage == nullptr) {
+      // nowhere to keep it, better a stall than a leak
+      vkDeviceWaitIdle(vk->createInfo.device);
+      vknvg_destroyGarbage(vk, &g);
+      return;
     }
-    if (tex->image != VK_NULL_HANDLE) {
-      vkDestroyImage(device, tex->image, allocator);
-      tex->image = VK_NULL_HANDLE;
+    vk->garbage = garbage;
+    vk->cgarbage = cgarbage;
+  }
+  g.frame = vk->frameIndex;
+  vk->garbage[vk->ngarbage++] = g;
+}
+
+// Destroys what was released framesInFlight frames ago or earlier, everything when all is set.
+static void vknvg_collectGarbage(VKNVGcontext *vk, bool all) {
+  int i, n = 0;
+  for (i = 0; i < vk->ngarbage; i++) {
+    if (all || vk->garbage[i].frame + vk->createInfo.framesInFlight <= vk->frameIndex) {
+      vknvg_destroyGarbage(vk, &vk->garbage[i]);
+    } else {
+      vk->garbage[n++] = vk->garbage[i];
     }
-    if (tex->mem != VK_NULL_HANDLE) {
-      vkFreeMemory(device, tex->mem, allocator);
-      tex->mem = VK_NULL_HANDLE;
+  }
+  vk->ngarbage = n;
+}
+
+static int vknvg_deleteTexture(VKNVGcontext *vk, VKNVGtexture *tex) {
+  if (tex && tex->id != 0) {
+    VKNVGgarbage g = {0};
+    g.view = tex->view;
+    g.image = tex->image;
+    g.mem = tex->mem;
+    g.textureSlot = vknvg_textureIndex(tex) + 1;
+    // stale handles stop matching right away, the slot is reused later
+    tex->id = 0;
+    tex->generation = (tex->generation + 1) & VKNVG_TEXTURE_GENERATION_MASK;
+    tex->view = VK_NULL_HANDLE;
+    tex->sampler = VK_NULL_HANDLE; // owned by the device cache
+    tex->image = VK_NULL_HANDLE;
+    tex->mem = VK_NULL_HANDLE;
+    if (!tex->evicted)
+      vk->textureMemory -= tex->memSize;
+    vknvg_release(vk, g);
+    if (tex->hostBuffer != VK_NULL_HANDLE) {
+      VKNVGgarbage host = {0};
+      host.buffer = tex->hostBuffer;
+      host.mem = tex->hostMem;
+      vknvg_release(vk, host);
+      tex->hostBuffer = VK_NULL_HANDLE;
+      tex->hostMem = VK_NULL_HANDLE;
     }
+    tex->hostPointer = nullptr;
     return 1;
   }
   return 0;
 }
 
-static VKNVGPipeline *vknvg_allocPipeline(VKNVGcontext *vk) {
+static void vknvg_evictTexture(VKNVGcontext *vk, VKNVGtexture *tex) {
+  VKNVGgarbage g = {0};
+  g.view = tex->view;
+  g.image = tex->image;
+  g.mem = tex->mem;
+  vknvg_release(vk, g);
+  tex->view = VK_NULL_HANDLE;
+  tex->image = VK_NULL_HANDLE;
+  tex->mem = VK_NULL_HANDLE;
+  tex->evicted = true;
+  vk->textureMemory -= tex->memSize;
+}
+
+// VK_EXT_memory_budget: 90% of the budget of the textures' heap, less what is not ours in it.
+// Unlimited without the extension, or when it reports no budget.
+static VkDeviceSize vknvg_heapTextureBudget(VKNVGcontext *vk) {
+  if (!vk->memoryBudget)
+    return VK_WHOLE_SIZE;
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT heapBudget = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 props = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
+  props.pNext = &heapBudget;
+  vkGetPhysicalDeviceMemoryProperties2(vk->createInfo.gpu, &props);
+  if (heapBudget.heapBudget[vk->textureHeap] == 0)
+    return VK_WHOLE_SIZE;
+  VkDeviceSize budget = heapBudget.heapBudget[vk->textureHeap] / 10 * 9;
+  VkDeviceSize usage = heapBudget.heapUsage[vk->textureHeap];
+  VkDeviceSize others = usage > vk->textureMemory ? usage - vk->textureMemory : 0;
+  return budget > others ? budget - others : 0;
+}
+
+static int vknvg_compareLastUsed(const void *a, const void *b) {
+  uint64_t lastUsedA = (*(VKNVGtexture *const *)a)->lastUsed;
+  uint64_t lastUsedB = (*(VKNVGtexture *const *)b)->lastUsed;
+  return lastUsedA < lastUsedB ? -1 : lastUsedA > lastUsedB;
+}
+
+// Evicts the least recently drawn textures until the resident ones fit in budget bytes.
+static void vknvg_evictTextures(VKNVGcontext *vk, VkDeviceSize budget) {
+  if (vk->restoreImage == nullptr || vk->textureMemory <= budget)
+    return;
+  // the candidates sorted by last use, evicted in that order
+  VKNVGtexture **lru = (VKNVGtexture **)malloc(sizeof(VKNVGtexture *) * vknvg_maxi(vk->ntextures, 1));
+  if (lru == nullptr)
+    return;
+  int i, n = 0;
+  for (i = 0; i < vk->ntextures; i++) {
+    VKNVGtexture *tex = vknvg_textureSlot(vk, i);
+    // frames in flight may still sample it, and in bindless mode read its descriptor
+    if (tex->id == 0 || !tex->evictable || tex->evicted || tex->lastUsed + vk->createInfo.framesInFlight >= vk->frameIndex)
+      continue;
+    lru[n++] = tex;
+  }
+  qsort(lru, n, sizeof(VKNVGtexture *), vknvg_compareLastUsed);
+  for (i = 0; i < n && vk->textureMemory > budget; i++) {
+    vknvg_evictTexture(vk, lru[i]);
+  }
+  free(lru);
+}
+
+static void vknvg_enforceTextureBudget(VKNVGcontext *vk) {
+  if (vk->restoreImage == nullptr)
+    return;
+  vknvg_evictTextures(vk, vk->textureBudget != 0 ? vk->textureBudget : vknvg_heapTextureBudget(vk));
+}
+
+// cache->mutex must be held
+static VKNVGPipeline *vknvg_allocPipeline(VKNVGdeviceCache *cache) {
   VKNVGPipeline *ret = nullptr;
-  if (vk->npipelines + 1 > vk->cpipelines) {
+  if (cache->npipelines + 1 > cache->cpipelines) {
     VKNVGPipeline *pipelines;
-    int cpipelines = vknvg_maxi(vk->npipelines + 1, 128) + vk->cpipelines / 2; // 1.5x Overallocate
-    pipelines = (VKNVGPipeline *)realloc(vk->pipelines, sizeof(VKNVGPipeline) * cpipelines);
+    int cpipelines = vknvg_maxi(cache->npipelines + 1, 128) + cache->cpipelines / 2; // 1.5x Overallocate
+    pipelines = (VKNVGPipeline *)realloc(cache->pipelines, sizeof(VKNVGPipeline) * cpipelines);
     if (pipelines == nullptr)
       return nullptr;
-    vk->pipelines = pipelines;
-    vk->cpipelines = cpipelines;
+    cache->pipelines = pipelines;
+    cache->cpipelines = cpipelines;
   }
-  ret = &vk->pipelines[vk->npipelines++];
+  ret = &cache->pipelines[cache->npipelines++];
   memset(ret, 0, sizeof(VKNVGPipeline));
   return ret;
 }
 static int vknvg_compareCreatePipelineKey(const VKNVGCreatePipelineKey *a, const VKNVGCreatePipelineKey *b) {
+  if (a->renderpass != b->renderpass) {
+    return a->renderpass < b->renderpass ? -1 : 1;
+  }
+  if (a->colorFormat != b->colorFormat) {
+    return a->colorFormat - b->colorFormat;
+  }
+  if (a->depthStencilFormat != b->depthStencilFormat) {
+    return a->depthStencilFormat - b->depthStencilFormat;
+  }
   if (a->topology != b->topology) {
     return a->topology - b->topology;
   }
@@ -307,12 +1037,48 @@ static int vknvg_compareCreatePipelineKey(const VKNVGCreatePipelineKey *a, const
   if (a->stencilTest != b->stencilTest) {
     return a->stencilTest - b->stencilTest;
   }
+  if (a->stencilClear != b->stencilClear) {
+    return a->stencilClear - b->stencilClear;
+  }
   if (a->edgeAA != b->edgeAA) {
     return a->edgeAA - b->edgeAA;
   }
   if (a->edgeAAShader != b->edgeAAShader) {
     return a->edgeAAShader - b->edgeAAShader;
   }
+  if (a->packedVertices != b->packedVertices) {
+    return a->packedVertices - b->packedVertices;
+  }
+  if (a->depthTest != b->depthTest) {
+    return a->depthTest - b->depthTest;
+  }
+  if (a->depthWrite != b->depthWrite) {
+    return a->depthWrite - b->depthWrite;
+  }
+  if (a->coverage != b->coverage) {
+    return a->coverage - b->coverage;
+  }
+  if (a->sampleCount != b->sampleCount) {
+    return a->sampleCount - b->sampleCount;
+  }
+  if (a->dynamicState != b->dynamicState) {
+    return a->dynamicState - b->dynamicState;
+  }
+  if (a->dynamicBlend != b->dynamicBlend) {
+    return a->dynamicBlend - b->dynamicBlend;
+  }
+  if (a->bindless != b->bindless) {
+    return a->bindless - b->bindless;
+  }
+  if (a->text != b->text) {
+    return a->text - b->text;
+  }
+  if (a->shaderType != b->shaderType) {
+    return a->shaderType - b->shaderType;
+  }
+  if (a->texType != b->texType) {
+    return a->texType - b->texType;
+  }
 
   if (a->compositOperation.srcRGB != b->compositOperation.srcRGB) {
     return a->compositOperation.srcRGB - b->compositOperation.srcRGB;
@@ -329,11 +1095,12 @@ static int vknvg_compareCreatePipelineKey(const VKNVGCreatePipelineKey *a, const
   return 0;
 }
 
-static VKNVGPipeline *vknvg_findPipeline(VKNVGcontext *vk, VKNVGCreatePipelineKey *pipelinekey) {
+// cache->mutex must be held
+static VKNVGPipeline *vknvg_findPipeline(VKNVGdeviceCache *cache, VKNVGCreatePipelineKey *pipelinekey) {
   VKNVGPipeline *pipeline = nullptr;
-  for (int i = 0; i < vk->npipelines; i++) {
-    if (vknvg_compareCreatePipelineKey(&vk->pipelines[i].create_key, pipelinekey) == 0) {
-      pipeline = &vk->pipelines[i];
+  for (int i = 0; i < cache->npipelines; i++) {
+    if (vknvg_compareCreatePipelineKey(&cache->pipelines[i].create_key, pipelinekey) == 0) {
+      pipeline = &cache->pipelines[i];
       break;
     }
   }
@@ -356,6 +1123,38 @@ static VkResult vknvg_memory_type_from_properties(VkPhysicalDeviceMemoryProperti
   return VK_ERROR_FORMAT_NOT_SUPPORTED;
 }
 
+static VkResult vknvg_createTextureImage(VKNVGcontext *vk, VKNVGtexture *tex);
+
+// Marks tex as drawn in this frame, bringing it back first if it was evicted. Returns 0 when it cannot be.
+static int vknvg_useTexture(VKNVGcontext *vk, VKNVGtexture *tex) {
+  tex->lastUsed = vk->frameIndex;
+  if (!tex->evicted)
+    return 1;
+  if (vknvg_createTextureImage(vk, tex) != VK_SUCCESS) {
+    // released memory returns once the frames in flight are done, the draw is retried later
+    vknvg_evictTextures(vk, vk->textureMemory > tex->memSize ? vk->textureMemory - tex->memSize : 0);
+    return 0;
+  }
+  if (!tex->restorePending) {
+    tex->restorePending = true;
+    vk->nrestores++;
+  }
+  return 1;
+}
+
+// Lets the application refill the textures recreated since the last flush.
+static void vknvg_restoreTextures(VKNVGcontext *vk) {
+  for (int i = 0; i < vk->ntextures && vk->nrestores > 0; i++) {
+    VKNVGtexture *tex = vknvg_textureSlot(vk, i);
+    if (!tex->restorePending)
+      continue;
+    tex->restorePending = false;
+    vk->nrestores--;
+    if (tex->id != 0 && !tex->evicted && vk->restoreImage)
+      vk->restoreImage(vk->restoreUserData, tex->id);
+  }
+}
+
 static int vknvg_convertPaint(VKNVGcontext *vk, VKNVGfragUniforms *frag, NVGpaint *paint,
                               NVGscissor *scissor, float width, float fringe, float strokeThr) {
   VKNVGtexture *tex = nullptr;
@@ -387,7 +1186,7 @@ static int vknvg_convertPaint(VKNVGcontext *vk, VKNVGfragUniforms *frag, NVGpain
 
   if (paint->image != 0) {
     tex = vknvg_findTexture(vk, paint->image);
-    if (tex == nullptr)
+    if (tex == nullptr || !vknvg_useTexture(vk, tex))
       return 0;
     if ((tex->flags & NVG_IMAGE_FLIPY) != 0) {
       float m1[6], m2[6];
@@ -403,46 +1202,76 @@ static int vknvg_convertPaint(VKNVGcontext *vk, VKNVGfragUniforms *frag, NVGpain
     }
     frag->type = NSVG_SHADER_FILLIMG;
 
-    if (tex->type == NVG_TEXTURE_RGBA)
-      frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
-    else
+    // alpha images broadcast R in their view and most straight alpha images are premultiplied at upload,
+    // only images sampled from memory this backend cannot rewrite still premultiply in the shader
+    if (tex->flags & NVG_IMAGE_MSDF)
+      frag->texType = 3;
+    else if (tex->flags & NVG_IMAGE_SDF)
       frag->texType = 2;
+    else if (tex->type == NVG_TEXTURE_RGBA && !(tex->flags & NVG_IMAGE_PREMULTIPLIED))
+      frag->texType = 1;
+    else
+      frag->texType = 0;
+    frag->sdfRange = tex->sdfRange;
     //		printf("frag->texType = %d\n", frag->texType);
   } else {
     frag->type = NSVG_SHADER_FILLGRAD;
     frag->radius = paint->radius;
     frag->feather = paint->feather;
     nvgTransformInverse(invxform, paint->xform);
+    tex = vknvg_findTexture(vk, vk->dummyImage);
   }
+  frag->texIndex = tex ? vknvg_textureIndex(tex) : 0;
 
   vknvg_xformToMat3x4(frag->paintMat, invxform);
 
   return 1;
 }
 
-static VKNVGBuffer vknvg_createBuffer(VkDevice device, VkPhysicalDeviceMemoryProperties memoryProperties, const VkAllocationCallbacks *allocator, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_type, void *data, uint32_t size) {
-
+// Leaves *buf empty on failure.
+static VkResult vknvg_tryCreateBuffer(VkDevice device, VkPhysicalDeviceMemoryProperties memoryProperties, const VkAllocationCallbacks *allocator, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_type, const void *data, VkDeviceSize size, VKNVGBuffer *buf) {
+  VKNVGBuffer empty = {0};
+  *buf = empty;
   const VkBufferCreateInfo buf_createInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr, 0, size, usage};
 
   VkBuffer buffer;
-  NVGVK_CHECK_RESULT(vkCreateBuffer(device, &buf_createInfo, allocator, &buffer));
+  VkResult res = vkCreateBuffer(device, &buf_createInfo, allocator, &buffer);
+  if (res != VK_SUCCESS)
+    return res;
   VkMemoryRequirements mem_reqs = {0};
   vkGetBufferMemoryRequirements(device, buffer, &mem_reqs);
 
-  uint32_t memoryTypeIndex;
-  VkResult res = vknvg_memory_type_from_properties(memoryProperties, mem_reqs.memoryTypeBits, memory_type, &memoryTypeIndex);
-  assert(res == VK_SUCCESS);
-  VkMemoryAllocateInfo mem_alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, mem_reqs.size, memoryTypeIndex};
-
-  VkDeviceMemory mem;
-  NVGVK_CHECK_RESULT(vkAllocateMemory(device, &mem_alloc, nullptr, &mem));
+  VkMemoryAllocateInfo mem_alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  mem_alloc.allocationSize = mem_reqs.size;
+  VkDeviceMemory mem = VK_NULL_HANDLE;
+  res = vknvg_memory_type_from_properties(memoryProperties, mem_reqs.memoryTypeBits, memory_type, &mem_alloc.memoryTypeIndex);
+  if (res == VK_SUCCESS)
+    res = vkAllocateMemory(device, &mem_alloc, allocator, &mem);
+  if (res == VK_SUCCESS && data != nullptr) {
+    void *mapped;
+    res = vkMapMemory(device, mem, 0, mem_alloc.allocationSize, 0, &mapped);
+    if (res == VK_SUCCESS) {
+      memcpy(mapped, data, (size_t)size);
+      vkUnmapMemory(device, mem);
+    }
+  }
+  if (res == VK_SUCCESS)
+    res = vkBindBufferMemory(device, buffer, mem, 0);
+  if (res != VK_SUCCESS) {
+    if (mem != VK_NULL_HANDLE)
+      vkFreeMemory(device, mem, allocator);
+    vkDestroyBuffer(device, buffer, allocator);
+    return res;
+  }
+  buf->buffer = buffer;
+  buf->mem = mem;
+  buf->size = mem_alloc.allocationSize;
+  return VK_SUCCESS;
+}
 
-  void *mapped;
-  NVGVK_CHECK_RESULT(vkMapMemory(device, mem, 0, mem_alloc.allocationSize, 0, &mapped));
-  memcpy(mapped, data, size);
-  vkUnmapMemory(device, mem);
-  NVGVK_CHECK_RESULT(vkBindBufferMemory(device, buffer, mem, 0));
-  VKNVGBuffer buf = {buffer, mem, mem_alloc.allocationSize};
+static VKNVGBuffer vknvg_createBuffer(VkDevice device, VkPhysicalDeviceMemoryProperties memoryProperties, const VkAllocationCallbacks *allocator, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_type, void *data, uint32_t size) {
+  VKNVGBuffer buf;
+  NVGVK_CHECK_RESULT(vknvg_tryCreateBuffer(device, memoryProperties, allocator, usage, memory_type, data, size, &buf));
   return buf;
 }
 
@@ -452,11 +1281,26 @@ static void vknvg_destroyBuffer(VkDevice device, const VkAllocationCallbacks *al
   vkFreeMemory(device, buffer->mem, allocator);
 }
 
-static void vknvg_UpdateBuffer(VkDevice device, const VkAllocationCallbacks *allocator, VKNVGBuffer *buffer, VkPhysicalDeviceMemoryProperties memoryProperties, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_type, void *data, uint32_t size) {
+static void vknvg_releaseBuffer(VKNVGcontext *vk, VKNVGBuffer *buffer) {
+  VKNVGgarbage g = {0};
+  g.buffer = buffer->buffer;
+  g.mem = buffer->mem;
+  vknvg_release(vk, g);
+  buffer->buffer = VK_NULL_HANDLE;
+  buffer->mem = VK_NULL_HANDLE;
+  buffer->size = 0;
+}
 
+static void vknvg_UpdateBuffer(VKNVGcontext *vk, VKNVGBuffer *buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_type, void *data, uint32_t size) {
+  VkDevice device = vk->createInfo.device;
+  // a frame made only of display lists has no vertices or uniforms of its own
+  if (size == 0) {
+    return;
+  }
   if (buffer->size < size) {
-    vknvg_destroyBuffer(device, allocator, buffer);
-    *buffer = vknvg_createBuffer(device, memoryProperties, allocator, usage, memory_type, data, size);
+    // the previous frame may still read the old one
+    vknvg_releaseBuffer(vk, buffer);
+    *buffer = vknvg_createBuffer(device, vk->memoryProperties, vk->createInfo.allocator, usage, memory_type, data, size);
   } else {
     void *mapped;
     NVGVK_CHECK_RESULT(vkMapMemory(device, buffer->mem, 0, size, 0, &mapped));
@@ -464,6 +1308,22 @@ static void vknvg_UpdateBuffer(VkDevice device, const VkAllocationCallbacks *all
     vkUnmapMemory(device, buffer->mem);
   }
 }
+// Uploads the arena's elements as one array.
+static void vknvg_UpdateArenaBuffer(VKNVGcontext *vk, VKNVGBuffer *buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlagBits memory_type, const VKNVGarena *arena) {
+  VkDevice device = vk->createInfo.device;
+  uint32_t size = (uint32_t)arena->count * arena->elemSize;
+  if (size == 0) {
+    return;
+  }
+  if (buffer->size < size) {
+    vknvg_releaseBuffer(vk, buffer);
+    *buffer = vknvg_createBuffer(device, vk->memoryProperties, vk->createInfo.allocator, usage, memory_type, nullptr, size);
+  }
+  void *mapped;
+  NVGVK_CHECK_RESULT(vkMapMemory(device, buffer->mem, 0, size, 0, &mapped));
+  vknvg_arenaCopy(arena, mapped, 0, arena->count);
+  vkUnmapMemory(device, buffer->mem);
+}
 
 static VkShaderModule vknvg_createShaderModule(VkDevice device, const void *code, size_t size, const VkAllocationCallbacks *allocator) {
 
@@ -528,7 +1388,7 @@ static VkPipelineColorBlendAttachmentState vknvg_compositOperationToColorBlendAt
 }
 
 static VkDescriptorSetLayout vknvg_createDescriptorSetLayout(VkDevice device, const VkAllocationCallbacks *allocator) {
-  const VkDescriptorSetLayoutBinding layout_binding[3] = {
+  const VkDescriptorSetLayoutBinding layout_binding[4] = {
       {
           0,
           VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -549,8 +1409,15 @@ static VkDescriptorSetLayout vknvg_createDescriptorSetLayout(VkDevice device, co
           1,
           VK_SHADER_STAGE_FRAGMENT_BIT,
           nullptr,
+      },
+      {
+          3,
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          1,
+          VK_SHADER_STAGE_FRAGMENT_BIT,
+          nullptr,
       }};
-  const VkDescriptorSetLayoutCreateInfo descriptor_layout = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 3, layout_binding};
+  const VkDescriptorSetLayoutCreateInfo descriptor_layout = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 4, layout_binding};
 
   VkDescriptorSetLayout descLayout;
   NVGVK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptor_layout, allocator, &descLayout));
@@ -558,45 +1425,134 @@ static VkDescriptorSetLayout vknvg_createDescriptorSetLayout(VkDevice device, co
   return descLayout;
 }
 
-static VkDescriptorPool vknvg_createDescriptorPool(VkDevice device, uint32_t count, const VkAllocationCallbacks *allocator) {
-
-  const VkDescriptorPoolSize type_count[3] = {
-      {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2 * count},
-      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4 * count},
-      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * count},
-  };
-  const VkDescriptorPoolCreateInfo descriptor_pool = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0, count * 2, 3, type_count};
-  VkDescriptorPool descPool;
-  NVGVK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptor_pool, allocator, &descPool));
-  return descPool;
-}
-static VkPipelineLayout vknvg_createPipelineLayout(VkDevice device, VkDescriptorSetLayout descLayout, const VkAllocationCallbacks *allocator) {
-  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
-  pipelineLayoutCreateInfo.setLayoutCount = 1;
-  pipelineLayoutCreateInfo.pSetLayouts = &descLayout;
-
-  VkPipelineLayout pipelineLayout;
+static VkDescriptorSetLayout vknvg_createStencilDescriptorSetLayout(VkDevice device, const VkAllocationCallbacks *allocator) {
+  const VkDescriptorSetLayoutBinding layout_binding[1] = {
+      {
+          0,
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+          1,
+          VK_SHADER_STAGE_VERTEX_BIT,
+          nullptr,
+      }};
+  const VkDescriptorSetLayoutCreateInfo descriptor_layout = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 1, layout_binding};
 
-  NVGVK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, allocator,
-                                            &pipelineLayout));
+  VkDescriptorSetLayout descLayout;
+  NVGVK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptor_layout, allocator, &descLayout));
 
-  return pipelineLayout;
+  return descLayout;
 }
 
-static VkPipelineDepthStencilStateCreateInfo initializeDepthStencilCreateInfo(VKNVGCreatePipelineKey *pipelinekey) {
-
-  VkPipelineDepthStencilStateCreateInfo ds = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
-  ds.depthWriteEnable = VK_FALSE;
-  ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-  ds.depthBoundsTestEnable = VK_FALSE;
-  ds.stencilTestEnable = VK_FALSE;
-  ds.back.failOp = VK_STENCIL_OP_KEEP;
-  ds.back.passOp = VK_STENCIL_OP_KEEP;
-  ds.back.compareOp = VK_COMPARE_OP_ALWAYS;
-  if (pipelinekey->stencilFill) {
-    ds.stencilTestEnable = VK_TRUE;
-    ds.front.compareOp = VK_COMPARE_OP_ALWAYS;
-    ds.front.failOp = VK_STENCIL_OP_KEEP;
+// NVG_BINDLESS_TEXTURES set 0: as vknvg_createDescriptorSetLayout, but the fragment uniforms are bound once per buffer
+// and selected with a dynamic offset, and the texture comes from set 1.
+static VkDescriptorSetLayout vknvg_createBindlessDescriptorSetLayout(VkDevice device, const VkAllocationCallbacks *allocator) {
+  const VkDescriptorSetLayoutBinding layout_binding[3] = {
+      {
+          0,
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+          1,
+          VK_SHADER_STAGE_VERTEX_BIT,
+          nullptr,
+      },
+      {
+          1,
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+          1,
+          VK_SHADER_STAGE_FRAGMENT_BIT,
+          nullptr,
+      },
+      {
+          3,
+          VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+          1,
+          VK_SHADER_STAGE_FRAGMENT_BIT,
+          nullptr,
+      }};
+  const VkDescriptorSetLayoutCreateInfo descriptor_layout = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, 3, layout_binding};
+
+  VkDescriptorSetLayout descLayout;
+  NVGVK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptor_layout, allocator, &descLayout));
+
+  return descLayout;
+}
+
+// NVG_BINDLESS_TEXTURES set 1: one element per texture slot. Slots are written when their texture is created, while
+// earlier frames may still be pending, and elements of free slots are never read.
+static VkDescriptorSetLayout vknvg_createTextureDescriptorSetLayout(VkDevice device, const VkAllocationCallbacks *allocator) {
+  const VkDescriptorSetLayoutBinding layout_binding = {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKNVG_MAX_BINDLESS_TEXTURES, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+  const VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+  const VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO, nullptr, 1, &binding_flags};
+  const VkDescriptorSetLayoutCreateInfo descriptor_layout = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, &flags_info, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, 1, &layout_binding};
+
+  VkDescriptorSetLayout descLayout;
+  NVGVK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptor_layout, allocator, &descLayout));
+
+  return descLayout;
+}
+
+static VkDescriptorPool vknvg_createDescriptorPool(VkDevice device, uint32_t count, const VkAllocationCallbacks *allocator) {
+
+  const VkDescriptorPoolSize type_count[5] = {
+      {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2 * count},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4 * count},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, count},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * count},
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * count},
+  };
+  const VkDescriptorPoolCreateInfo descriptor_pool = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0, count * 2, 5, type_count};
+  VkDescriptorPool descPool;
+  NVGVK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptor_pool, allocator, &descPool));
+  return descPool;
+}
+static VkDescriptorPool vknvg_createTextureDescriptorPool(VkDevice device, const VkAllocationCallbacks *allocator) {
+  const VkDescriptorPoolSize type_count = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VKNVG_MAX_BINDLESS_TEXTURES};
+  const VkDescriptorPoolCreateInfo descriptor_pool = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT, 1, 1, &type_count};
+  VkDescriptorPool descPool;
+  NVGVK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptor_pool, allocator, &descPool));
+  return descPool;
+}
+// Every layout has the same push constant range, so push constants survive switching between them.
+static VkPipelineLayout vknvg_createPipelineLayout(VkDevice device, uint32_t setCount, const VkDescriptorSetLayout *descLayouts, const VkAllocationCallbacks *allocator) {
+  VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(VKNVGpushConstants)};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  pipelineLayoutCreateInfo.setLayoutCount = setCount;
+  pipelineLayoutCreateInfo.pSetLayouts = descLayouts;
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+  VkPipelineLayout pipelineLayout;
+
+  NVGVK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, allocator,
+                                            &pipelineLayout));
+
+  return pipelineLayout;
+}
+
+static VkPipelineDepthStencilStateCreateInfo initializeDepthStencilCreateInfo(const VKNVGCreatePipelineKey *pipelinekey) {
+
+  VkPipelineDepthStencilStateCreateInfo ds = {VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+  ds.depthTestEnable = pipelinekey->depthTest ? VK_TRUE : VK_FALSE;
+  ds.depthWriteEnable = pipelinekey->depthWrite ? VK_TRUE : VK_FALSE;
+  ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  ds.depthBoundsTestEnable = VK_FALSE;
+  ds.stencilTestEnable = VK_FALSE;
+  ds.back.failOp = VK_STENCIL_OP_KEEP;
+  ds.back.passOp = VK_STENCIL_OP_KEEP;
+  ds.back.compareOp = VK_COMPARE_OP_ALWAYS;
+  if (pipelinekey->stencilClear) {
+    ds.stencilTestEnable = VK_TRUE;
+    ds.front.compareOp = VK_COMPARE_OP_ALWAYS;
+    ds.front.reference = 0x0;
+    ds.front.compareMask = 0xff;
+    ds.front.writeMask = 0xff;
+    ds.front.failOp = VK_STENCIL_OP_ZERO;
+    ds.front.depthFailOp = VK_STENCIL_OP_ZERO;
+    ds.front.passOp = VK_STENCIL_OP_ZERO;
+    ds.back = ds.front;
+  } else if (pipelinekey->stencilFill) {
+    ds.stencilTestEnable = VK_TRUE;
+    ds.front.compareOp = VK_COMPARE_OP_ALWAYS;
+    ds.front.failOp = VK_STENCIL_OP_KEEP;
     ds.front.depthFailOp = VK_STENCIL_OP_KEEP;
     ds.front.passOp = VK_STENCIL_OP_INCREMENT_AND_WRAP;
     ds.front.reference = 0x0;
@@ -628,24 +1584,31 @@ static VkPipelineDepthStencilStateCreateInfo initializeDepthStencilCreateInfo(VK
 
   return ds;
 }
-static VKNVGPipeline *vknvg_createPipeline(VKNVGcontext *vk, VKNVGCreatePipelineKey *pipelinekey) {
+static bool vknvg_formatHasDepth(VkFormat format) {
+  return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT ||
+         format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+static bool vknvg_formatHasStencil(VkFormat format) {
+  return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+static VkPipeline vknvg_createPipeline(VKNVGdeviceCache *cache, VKNVGCreatePipelineKey *pipelinekey) {
 
-  VkDevice device = vk->createInfo.device;
-  VkPipelineLayout pipelineLayout = vk->pipelineLayout;
-  VkRenderPass renderpass = vk->createInfo.renderpass;
-  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+  VkDevice device = cache->device;
+  const bool stencilOnly = pipelinekey->shaderType == NSVG_SHADER_SIMPLE;
+  VkPipelineLayout pipelineLayout = stencilOnly ? cache->stencilPipelineLayout : (pipelinekey->bindless ? cache->bindlessPipelineLayout : cache->pipelineLayout);
+  VkRenderPass renderpass = pipelinekey->renderpass;
+  const VkAllocationCallbacks *allocator = cache->allocator;
 
-  VkDescriptorSetLayout descLayout = vk->descLayout;
-  VkShaderModule vert_shader = vk->fillVertShader;
-  VkShaderModule frag_shader = vk->fillFragShader;
-  VkShaderModule frag_shader_aa = vk->fillFragShaderAA;
+  VkShaderModule vert_shader = pipelinekey->text ? cache->textVertShader : cache->fillVertShader;
+  VkShaderModule frag_shader = pipelinekey->bindless ? cache->fillBindlessFragShader : cache->fillFragShader;
 
   VkVertexInputBindingDescription vi_bindings[1] = {{0}};
   vi_bindings[0].binding = 0;
-  vi_bindings[0].stride = sizeof(NVGvertex);
+  vi_bindings[0].stride = pipelinekey->packedVertices ? sizeof(VKNVGpackedVertex) : sizeof(NVGvertex);
   vi_bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-  VkVertexInputAttributeDescription vi_attrs[2] = {
+  VkVertexInputAttributeDescription vi_attrs[3] = {
       {0},
   };
   vi_attrs[0].binding = 0;
@@ -656,11 +1619,30 @@ static VKNVGPipeline *vknvg_createPipeline(VKNVGcontext *vk, VKNVGCreatePipeline
   vi_attrs[1].location = 1;
   vi_attrs[1].format = VK_FORMAT_R32G32_SFLOAT;
   vi_attrs[1].offset = (2 * sizeof(float));
+  if (pipelinekey->packedVertices) {
+    vi_attrs[0].format = VK_FORMAT_R16G16_SNORM;
+    vi_attrs[1].format = VK_FORMAT_R16G16_UNORM;
+    vi_attrs[1].offset = (2 * sizeof(int16_t));
+  }
+  uint32_t vi_attrCount = 2;
+  if (pipelinekey->text) {
+    vi_bindings[0].stride = sizeof(VKNVGglyph);
+    vi_bindings[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    vi_attrs[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vi_attrs[0].offset = offsetof(VKNVGglyph, rect);
+    vi_attrs[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vi_attrs[1].offset = offsetof(VKNVGglyph, uv);
+    vi_attrs[2].binding = 0;
+    vi_attrs[2].location = 2;
+    vi_attrs[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+    vi_attrs[2].offset = offsetof(VKNVGglyph, color);
+    vi_attrCount = 3;
+  }
 
   VkPipelineVertexInputStateCreateInfo vi = {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
   vi.vertexBindingDescriptionCount = 1;
   vi.pVertexBindingDescriptions = vi_bindings;
-  vi.vertexAttributeDescriptionCount = 2;
+  vi.vertexAttributeDescriptionCount = vi_attrCount;
   vi.pVertexAttributeDescriptions = vi_attrs;
 
   VkPipelineInputAssemblyStateCreateInfo ia = {VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
@@ -679,8 +1661,14 @@ static VKNVGPipeline *vknvg_createPipeline(VKNVGcontext *vk, VKNVGCreatePipeline
 
   if (pipelinekey->stencilFill) {
     rs.cullMode = VK_CULL_MODE_NONE;
+  }
+  if (stencilOnly && !pipelinekey->dynamicBlend) {
     colorblend.colorWriteMask = 0;
   }
+  if (pipelinekey->depthWrite) {
+    // only opaque fragments write depth, there is nothing to blend
+    colorblend.blendEnable = VK_FALSE;
+  }
 
   VkPipelineColorBlendStateCreateInfo cb = {VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
   cb.attachmentCount = 1;
@@ -690,30 +1678,73 @@ static VKNVGPipeline *vknvg_createPipeline(VKNVGcontext *vk, VKNVGCreatePipeline
   vp.viewportCount = 1;
   vp.scissorCount = 1;
 
-  VkDynamicState dynamicStateEnables[VK_DYNAMIC_STATE_RANGE_SIZE] = {
+  VkDynamicState dynamicStateEnables[11] = {
       VK_DYNAMIC_STATE_VIEWPORT,
       VK_DYNAMIC_STATE_SCISSOR};
+  uint32_t dynamicStateCount = 2;
+  if (pipelinekey->dynamicState) {
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_CULL_MODE_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_STENCIL_OP_EXT;
+  }
+#ifdef VK_EXT_extended_dynamic_state3
+  if (pipelinekey->dynamicBlend) {
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT;
+    dynamicStateEnables[dynamicStateCount++] = VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT;
+  }
+#endif
 
   VkPipelineDynamicStateCreateInfo dynamicState = {VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
-  dynamicState.dynamicStateCount = 2;
+  dynamicState.dynamicStateCount = dynamicStateCount;
   dynamicState.pDynamicStates = dynamicStateEnables;
 
   VkPipelineDepthStencilStateCreateInfo ds = initializeDepthStencilCreateInfo(pipelinekey);
+  if (pipelinekey->dynamicState) {
+    // ops and enables are set per pass, the masks and the reference are the same for all of them
+    ds.front.compareMask = 0xff;
+    ds.front.writeMask = 0xff;
+    ds.front.reference = 0x0;
+    ds.back.compareMask = 0xff;
+    ds.back.writeMask = 0xff;
+    ds.back.reference = 0x0;
+  }
 
   VkPipelineMultisampleStateCreateInfo ms = {VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
   ms.pSampleMask = nullptr;
-  ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  ms.rasterizationSamples = pipelinekey->sampleCount;
 
   VkPipelineShaderStageCreateInfo shaderStages[2] = {{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO}, {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO}};
   shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
   shaderStages[0].module = vert_shader;
   shaderStages[0].pName = "main";
 
+  // constant_id 0..3 of fill.frag
+  struct {
+    int32_t shaderType;
+    int32_t texType;
+    VkBool32 edgeAA;
+    VkBool32 coverage;
+  } specData = {pipelinekey->shaderType, pipelinekey->texType, (VkBool32)(pipelinekey->edgeAAShader ? VK_TRUE : VK_FALSE),
+                (VkBool32)(pipelinekey->coverage ? VK_TRUE : VK_FALSE)};
+  const VkSpecializationMapEntry specEntries[4] = {
+      {0, 0, sizeof(int32_t)},
+      {1, sizeof(int32_t), sizeof(int32_t)},
+      {2, 2 * sizeof(int32_t), sizeof(VkBool32)},
+      {3, 2 * sizeof(int32_t) + sizeof(VkBool32), sizeof(VkBool32)},
+  };
+  VkSpecializationInfo specInfo = {4, specEntries, sizeof(specData), &specData};
+
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   shaderStages[1].module = frag_shader;
   shaderStages[1].pName = "main";
-  if (pipelinekey->edgeAAShader) {
-    shaderStages[1].module = frag_shader_aa;
+  shaderStages[1].pSpecializationInfo = &specInfo;
+  if (stencilOnly) {
+    shaderStages[1].module = cache->stencilFragShader;
+    shaderStages[1].pSpecializationInfo = nullptr;
   }
 
   VkGraphicsPipelineCreateInfo pipelineCreateInfo = {VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
@@ -730,29 +1761,151 @@ static VKNVGPipeline *vknvg_createPipeline(VKNVGcontext *vk, VKNVGCreatePipeline
   pipelineCreateInfo.renderPass = renderpass;
   pipelineCreateInfo.pDynamicState = &dynamicState;
 
+  VkPipelineRenderingCreateInfo renderingInfo = {VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO};
+  if (renderpass == VK_NULL_HANDLE) {
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &pipelinekey->colorFormat;
+    // only the aspects the format has
+    VkFormat depthStencilFormat = pipelinekey->depthStencilFormat;
+    renderingInfo.depthAttachmentFormat = vknvg_formatHasDepth(depthStencilFormat) ? depthStencilFormat : VK_FORMAT_UNDEFINED;
+    renderingInfo.stencilAttachmentFormat = vknvg_formatHasStencil(depthStencilFormat) ? depthStencilFormat : VK_FORMAT_UNDEFINED;
+    pipelineCreateInfo.pNext = &renderingInfo;
+  }
+
   VkPipeline pipeline;
-  NVGVK_CHECK_RESULT(vkCreateGraphicsPipelines(device, 0, 1, &pipelineCreateInfo, allocator, &pipeline));
+  if (vkCreateGraphicsPipelines(device, 0, 1, &pipelineCreateInfo, allocator, &pipeline) != VK_SUCCESS)
+    return VK_NULL_HANDLE;
+  return pipeline;
+}
+
+// Returns the pipeline for the key, compiling it on first use. Compilation runs outside the lock so that
+// contexts on other threads are not blocked; if two threads race on the same key the loser's pipeline is dropped.
+// VK_NULL_HANDLE when the pipeline cannot be created or stored, to be tried again on the next use.
+static VkPipeline vknvg_getPipeline(VKNVGdeviceCache *cache, VKNVGCreatePipelineKey *pipelinekey) {
+  VkPipeline ret = VK_NULL_HANDLE;
 
-  VKNVGPipeline *ret = vknvg_allocPipeline(vk);
+  vknvg_mutexLock(&cache->mutex);
+  VKNVGPipeline *pipeline = vknvg_findPipeline(cache, pipelinekey);
+  if (pipeline) {
+    ret = pipeline->pipeline;
+  }
+  vknvg_mutexUnlock(&cache->mutex);
+  if (ret != VK_NULL_HANDLE) {
+    return ret;
+  }
+
+  VkPipeline created = vknvg_createPipeline(cache, pipelinekey);
+  if (created == VK_NULL_HANDLE) {
+    return VK_NULL_HANDLE;
+  }
+
+  vknvg_mutexLock(&cache->mutex);
+  pipeline = vknvg_findPipeline(cache, pipelinekey);
+  if (pipeline) {
+    ret = pipeline->pipeline;
+  } else {
+    pipeline = vknvg_allocPipeline(cache);
+    if (pipeline) {
+      pipeline->create_key = *pipelinekey;
+      pipeline->pipeline = created;
+      ret = created;
+    }
+  }
+  vknvg_mutexUnlock(&cache->mutex);
 
-  ret->create_key = *pipelinekey;
-  ret->pipeline = pipeline;
+  if (ret != created) {
+    vkDestroyPipeline(cache->device, created, cache->allocator);
+  }
   return ret;
 }
 
-static VkPipeline vknvg_bindPipeline(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, VKNVGCreatePipelineKey *pipelinekey) {
-  VKNVGPipeline *pipeline = vknvg_findPipeline(vk, pipelinekey);
-  if (!pipeline) {
-    pipeline = vknvg_createPipeline(vk, pipelinekey);
+// NVG_DYNAMIC_STATE: sets what the key's pipeline would have baked in.
+static void vknvg_setDynamicState(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, const VKNVGCreatePipelineKey *key) {
+  if (vk->dynamicStateSet && vknvg_compareCreatePipelineKey(key, &vk->dynamicStateKey) == 0) {
+    return;
+  }
+  VkPipelineDepthStencilStateCreateInfo ds = initializeDepthStencilCreateInfo(key);
+  vk->cmdSetPrimitiveTopology(cmdBuffer, key->topology);
+  vk->cmdSetCullMode(cmdBuffer, key->stencilFill ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT);
+  vk->cmdSetDepthTestEnable(cmdBuffer, ds.depthTestEnable);
+  vk->cmdSetDepthWriteEnable(cmdBuffer, ds.depthWriteEnable);
+  vk->cmdSetStencilTestEnable(cmdBuffer, ds.stencilTestEnable);
+  vk->cmdSetStencilOp(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT, ds.front.failOp, ds.front.passOp, ds.front.depthFailOp, ds.front.compareOp);
+  vk->cmdSetStencilOp(cmdBuffer, VK_STENCIL_FACE_BACK_BIT, ds.back.failOp, ds.back.passOp, ds.back.depthFailOp, ds.back.compareOp);
+#ifdef VK_EXT_extended_dynamic_state3
+  if (vk->dynamicBlend) {
+    VkPipelineColorBlendAttachmentState blend = vknvg_compositOperationToColorBlendAttachmentState(key->compositOperation);
+    VkBool32 blendEnable = key->depthWrite ? VK_FALSE : VK_TRUE;
+    VkColorBlendEquationEXT equation = {blend.srcColorBlendFactor, blend.dstColorBlendFactor, blend.colorBlendOp,
+                                        blend.srcAlphaBlendFactor, blend.dstAlphaBlendFactor, blend.alphaBlendOp};
+    VkColorComponentFlags writeMask = key->shaderType == NSVG_SHADER_SIMPLE ? 0 : blend.colorWriteMask;
+    vk->cmdSetColorBlendEnable(cmdBuffer, 0, 1, &blendEnable);
+    vk->cmdSetColorBlendEquation(cmdBuffer, 0, 1, &equation);
+    vk->cmdSetColorWriteMask(cmdBuffer, 0, 1, &writeMask);
+  }
+#endif
+  vk->dynamicStateKey = *key;
+  vk->dynamicStateSet = true;
+}
+
+// Returns VK_NULL_HANDLE, binding nothing, when the pipeline is unavailable: the caller skips its draws.
+static VkPipeline vknvg_bindPipeline(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, const VKNVGCreatePipelineKey *pipelinekey) {
+  VKNVGCreatePipelineKey key = *pipelinekey;
+  key.renderpass = vk->renderpass;
+  if (key.renderpass == VK_NULL_HANDLE) {
+    key.colorFormat = vk->createInfo.colorFormat;
+    key.depthStencilFormat = vk->createInfo.depthStencilFormat;
+  }
+  key.packedVertices = (vk->flags & NVG_PACKED_VERTICES) != 0 && !key.text;
+  key.depthTest = (vk->flags & NVG_DEPTH_OVERDRAW) != 0;
+  key.sampleCount = vk->boundFramebuffer ? VK_SAMPLE_COUNT_1_BIT : vk->createInfo.sampleCount;
+  // Drop what the selected shader variant ignores so that equivalent keys share a pipeline.
+  if (key.shaderType != NSVG_SHADER_FILLIMG && key.shaderType != NSVG_SHADER_IMG) {
+    key.texType = 0;
+  }
+  if (key.shaderType == NSVG_SHADER_SIMPLE) {
+    NVGcompositeOperationState noBlend = {0};
+    key.edgeAAShader = false;
+    key.compositOperation = noBlend;
+  } else {
+    key.bindless = (vk->flags & NVG_BINDLESS_TEXTURES) != 0;
+  }
+  const VKNVGCreatePipelineKey state = key;
+  if (vk->dynamicState) {
+    // set by vknvg_setDynamicState, so the passes of a call share one pipeline
+    key.dynamicState = true;
+    key.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    key.stencilFill = false;
+    key.stencilTest = false;
+    key.stencilClear = false;
+    key.edgeAA = false;
+    key.depthTest = false;
+    if (vk->dynamicBlend) {
+      NVGcompositeOperationState noBlend = {0};
+      key.dynamicBlend = true;
+      key.depthWrite = false;
+      key.compositOperation = noBlend;
+    }
+  }
+  VkPipeline pipeline = vknvg_getPipeline(vk->cache, &key);
+  if (pipeline == VK_NULL_HANDLE) {
+    return VK_NULL_HANDLE;
   }
   if (pipeline != vk->currentPipeline) {
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
     vk->currentPipeline = pipeline;
   }
-  return pipeline->pipeline;
+  if (vk->dynamicState) {
+    vknvg_setDynamicState(vk, cmdBuffer, &state);
+  }
+  return pipeline;
 }
 
+// data holds the whole image, of which the w x h texels at dx, dy are written.
 static int vknvg_UpdateTexture(VkDevice device, VKNVGtexture *tex, int dx, int dy, int w, int h, const unsigned char *data) {
+  if (!tex->mappable) {
+    return 0;
+  }
 
   VkMemoryRequirements mem_reqs;
   vkGetImageMemoryRequirements(device, tex->image, &mem_reqs);
@@ -764,9 +1917,21 @@ static int vknvg_UpdateTexture(VkDevice device, VKNVGtexture *tex, int dx, int d
   NVGVK_CHECK_RESULT(vkMapMemory(device, tex->mem, 0, mem_reqs.size, 0, &bindptr));
   int comp_size = (tex->type == NVG_TEXTURE_RGBA) ? 4 : 1;
   for (int y = 0; y < h; ++y) {
-    char *src = (char *)data + ((dy + y) * (tex->width * comp_size)) + dx;
-    char *dest = (char *)bindptr + ((dy + y) * layout.rowPitch) + dx;
-    memcpy(dest, src, w * comp_size);
+    char *src = (char *)data + ((dy + y) * (tex->width * comp_size)) + dx * comp_size;
+    char *dest = (char *)bindptr + layout.offset + ((dy + y) * layout.rowPitch) + dx * comp_size;
+    if (tex->premultiply) {
+      const unsigned char *s = (const unsigned char *)src;
+      unsigned char *d = (unsigned char *)dest;
+      for (int x = 0; x < w * 4; x += 4) {
+        unsigned a = s[x + 3];
+        d[x + 0] = (unsigned char)((s[x + 0] * a + 127) / 255);
+        d[x + 1] = (unsigned char)((s[x + 1] * a + 127) / 255);
+        d[x + 2] = (unsigned char)((s[x + 2] * a + 127) / 255);
+        d[x + 3] = (unsigned char)a;
+      }
+    } else {
+      memcpy(dest, src, w * comp_size);
+    }
   }
   vkUnmapMemory(device, tex->mem);
   return 1;
@@ -782,70 +1947,111 @@ static int vknvg_maxVertCount(const NVGpath *paths, int npaths) {
 }
 
 static VKNVGcall *vknvg_allocCall(VKNVGcontext *vk) {
-  VKNVGcall *ret = nullptr;
-  if (vk->ncalls + 1 > vk->ccalls) {
-    VKNVGcall *calls;
-    int ccalls = vknvg_maxi(vk->ncalls + 1, 128) + vk->ccalls / 2; // 1.5x Overallocate
-    calls = (VKNVGcall *)realloc(vk->calls, sizeof(VKNVGcall) * ccalls);
-    if (calls == nullptr)
-      return nullptr;
-    vk->calls = calls;
-    vk->ccalls = ccalls;
-  }
-  ret = &vk->calls[vk->ncalls++];
+  int i = vknvg_arenaAlloc(&vk->calls, 1);
+  if (i == -1)
+    return nullptr;
+  VKNVGcall *ret = (VKNVGcall *)vknvg_arenaPtr(&vk->calls, i);
   memset(ret, 0, sizeof(VKNVGcall));
   return ret;
 }
+static VKNVGcall *vknvg_frameCall(VKNVGcontext *vk, int i) {
+  return (VKNVGcall *)vknvg_arenaPtr(&vk->calls, i);
+}
 
 static int vknvg_allocPaths(VKNVGcontext *vk, int n) {
-  int ret = 0;
-  if (vk->npaths + n > vk->cpaths) {
-    VKNVGpath *paths;
-    int cpaths = vknvg_maxi(vk->npaths + n, 128) + vk->cpaths / 2; // 1.5x Overallocate
-    paths = (VKNVGpath *)realloc(vk->paths, sizeof(VKNVGpath) * cpaths);
-    if (paths == nullptr)
-      return -1;
-    vk->paths = paths;
-    vk->cpaths = cpaths;
+  return vknvg_arenaAlloc(&vk->paths, n);
+}
+static VKNVGpath *vknvg_callPaths(VKNVGcontext *vk, const VKNVGcall *call) {
+  if (vk->drawPaths != nullptr) {
+    return &vk->drawPaths[call->pathOffset];
   }
-  ret = vk->npaths;
-  vk->npaths += n;
-  return ret;
+  return (VKNVGpath *)vknvg_arenaPtr(&vk->paths, call->pathOffset);
 }
 
 static int vknvg_allocVerts(VKNVGcontext *vk, int n) {
-  int ret = 0;
-  if (vk->nverts + n > vk->cverts) {
-    NVGvertex *verts;
-    int cverts = vknvg_maxi(vk->nverts + n, 4096) + vk->cverts / 2; // 1.5x Overallocate
-    verts = (NVGvertex *)realloc(vk->verts, sizeof(NVGvertex) * cverts);
-    if (verts == nullptr)
-      return -1;
-    vk->verts = verts;
-    vk->cverts = cverts;
+  int ret = vknvg_arenaAlloc(&vk->verts, n);
+  if (ret == -1)
+    return -1;
+  // both arenas hand out the same indices as long as they advance together
+  if ((vk->flags & NVG_PACKED_VERTICES) && vknvg_arenaAlloc(&vk->packedVerts, n) == -1) {
+    vknvg_arenaRewind(&vk->verts, ret);
+    return -1;
   }
-  ret = vk->nverts;
-  vk->nverts += n;
   return ret;
 }
+static NVGvertex *vknvg_vertPtr(VKNVGcontext *vk, int i) {
+  return (NVGvertex *)vknvg_arenaPtr(&vk->verts, i);
+}
 
+// Returns a byte offset, as bound in the descriptor sets.
 static int vknvg_allocFragUniforms(VKNVGcontext *vk, int n) {
-  int ret = 0, structSize = vk->fragSize;
-  if (vk->nuniforms + n > vk->cuniforms) {
-    unsigned char *uniforms;
-    int cuniforms = vknvg_maxi(vk->nuniforms + n, 128) + vk->cuniforms / 2; // 1.5x Overallocate
-    uniforms = (unsigned char *)realloc(vk->uniforms, structSize * cuniforms);
-    if (uniforms == nullptr)
-      return -1;
-    vk->uniforms = uniforms;
-    vk->cuniforms = cuniforms;
-  }
-  ret = vk->nuniforms * structSize;
-  vk->nuniforms += n;
-  return ret;
+  int ret = vknvg_arenaAlloc(&vk->uniforms, n);
+  if (ret == -1)
+    return -1;
+  return ret * vk->fragSize;
 }
+static int vknvg_allocCoverage(VKNVGcontext *vk, int n) {
+  return vknvg_arenaAlloc(&vk->coverage, n);
+}
+
 static VKNVGfragUniforms *vknvg_fragUniformPtr(VKNVGcontext *vk, int i) {
-  return (VKNVGfragUniforms *)&vk->uniforms[i];
+  return (VKNVGfragUniforms *)vknvg_arenaPtr(&vk->uniforms, i / vk->fragSize);
+}
+
+// Computes a pixel rect containing everything the scissor lets through, snapped outwards.
+// Rasterization rejects fragments outside of it, scissorMask in the shader still does the exact antialiased clip.
+static bool vknvg_scissorRect(VKNVGcontext *vk, const NVGscissor *scissor, float fringe, VkRect2D *rect) {
+  if (scissor->extent[0] < -0.5f || scissor->extent[1] < -0.5f) {
+    return false;
+  }
+  const float *t = scissor->xform;
+  // bounding box of the transformed rect, grown by the width of the antialiased edge
+  float ex = scissor->extent[0] * fabsf(t[0]) + scissor->extent[1] * fabsf(t[2]) + fringe;
+  float ey = scissor->extent[0] * fabsf(t[1]) + scissor->extent[1] * fabsf(t[3]) + fringe;
+  float scale = vk->devicePixelRatio;
+  float x0 = floorf((t[4] - ex) * scale), y0 = floorf((t[5] - ey) * scale);
+  float x1 = ceilf((t[4] + ex) * scale), y1 = ceilf((t[5] + ey) * scale);
+  float w = (float)vk->viewScissor.extent.width, h = (float)vk->viewScissor.extent.height;
+  x0 = x0 < 0.0f ? 0.0f : (x0 > w ? w : x0);
+  y0 = y0 < 0.0f ? 0.0f : (y0 > h ? h : y0);
+  x1 = x1 < x0 ? x0 : (x1 > w ? w : x1);
+  y1 = y1 < y0 ? y0 : (y1 > h ? h : y1);
+  rect->offset.x = (int32_t)x0 + vk->viewScissor.offset.x;
+  rect->offset.y = (int32_t)y0 + vk->viewScissor.offset.y;
+  rect->extent.width = (uint32_t)(x1 - x0);
+  rect->extent.height = (uint32_t)(y1 - y0);
+  return true;
+}
+
+static void vknvg_boundsInit(float *bounds) {
+  bounds[0] = bounds[1] = FLT_MAX;
+  bounds[2] = bounds[3] = -FLT_MAX;
+}
+
+static void vknvg_boundsAdd(float *bounds, const NVGvertex *verts, int nverts) {
+  for (int i = 0; i < nverts; i++) {
+    bounds[0] = verts[i].x < bounds[0] ? verts[i].x : bounds[0];
+    bounds[1] = verts[i].y < bounds[1] ? verts[i].y : bounds[1];
+    bounds[2] = verts[i].x > bounds[2] ? verts[i].x : bounds[2];
+    bounds[3] = verts[i].y > bounds[3] ? verts[i].y : bounds[3];
+  }
+}
+
+// Whether bounds (canvas space) reach into the view and the scissor rect. Display lists are captured
+// unculled since they are replayed with another transform.
+static bool vknvg_boundsVisible(VKNVGcontext *vk, const float *bounds, bool scissored, const VkRect2D *scissorRect) {
+  if (vk->capturing || vk->devicePixelRatio <= 0.0f) {
+    return true;
+  }
+  float x0 = 0.0f, y0 = 0.0f, x1 = vk->view[0], y1 = vk->view[1];
+  if (scissored) {
+    float inv = 1.0f / vk->devicePixelRatio;
+    x0 = (scissorRect->offset.x - vk->viewScissor.offset.x) * inv;
+    y0 = (scissorRect->offset.y - vk->viewScissor.offset.y) * inv;
+    x1 = x0 + scissorRect->extent.width * inv;
+    y1 = y0 + scissorRect->extent.height * inv;
+  }
+  return bounds[2] > x0 && bounds[0] < x1 && bounds[3] > y0 && bounds[1] < y1;
 }
 
 static void vknvg_vset(NVGvertex *vtx, float x, float y, float u, float v) {
@@ -855,13 +2061,207 @@ static void vknvg_vset(NVGvertex *vtx, float x, float y, float u, float v) {
   vtx->v = v;
 }
 
+// Quantizes the call's vertices verts[offset, offset + n) into packedVerts, relative to their bounding box.
+static void vknvg_packVertices(VKNVGcontext *vk, VKNVGcall *call, int offset, int n) {
+  const NVGvertex *src = vknvg_vertPtr(vk, offset);
+  VKNVGpackedVertex *dst = (VKNVGpackedVertex *)vknvg_arenaPtr(&vk->packedVerts, offset);
+  float lo[4] = {0.0f, 0.0f, 0.0f, 0.0f}, hi[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  float bias[4], scale[4], inv[4];
+  int i = 0;
+
+  if (n > 0) {
+#ifdef VKNVG_SSE2
+    __m128 vmin = _mm_loadu_ps(&src[0].x), vmax = vmin;
+    for (i = 1; i < n; i++) {
+      __m128 v = _mm_loadu_ps(&src[i].x);
+      vmin = _mm_min_ps(vmin, v);
+      vmax = _mm_max_ps(vmax, v);
+    }
+    _mm_storeu_ps(lo, vmin);
+    _mm_storeu_ps(hi, vmax);
+#else
+    memcpy(lo, &src[0].x, sizeof(lo));
+    memcpy(hi, &src[0].x, sizeof(hi));
+    for (i = 1; i < n; i++) {
+      const float *v = &src[i].x;
+      for (int c = 0; c < 4; c++) {
+        lo[c] = v[c] < lo[c] ? v[c] : lo[c];
+        hi[c] = v[c] > hi[c] ? v[c] : hi[c];
+      }
+    }
+#endif
+  }
+
+  // snorm positions around the center, unorm tcoords from the minimum
+  bias[0] = (lo[0] + hi[0]) * 0.5f;
+  bias[1] = (lo[1] + hi[1]) * 0.5f;
+  bias[2] = lo[2];
+  bias[3] = lo[3];
+  scale[0] = (hi[0] - lo[0]) * 0.5f;
+  scale[1] = (hi[1] - lo[1]) * 0.5f;
+  scale[2] = hi[2] - lo[2];
+  scale[3] = hi[3] - lo[3];
+  for (int c = 0; c < 4; c++) {
+    const float range = c < 2 ? 32767.0f : 65535.0f;
+    inv[c] = scale[c] > 0.0f ? range / scale[c] : 0.0f;
+  }
+
+  call->posDequant[0] = scale[0];
+  call->posDequant[1] = scale[1];
+  call->posDequant[2] = bias[0];
+  call->posDequant[3] = bias[1];
+  call->uvDequant[0] = scale[2];
+  call->uvDequant[1] = scale[3];
+  call->uvDequant[2] = bias[2];
+  call->uvDequant[3] = bias[3];
+
+  i = 0;
+#ifdef VKNVG_SSE2
+  {
+    // tcoords are shifted into the signed range so that both halves saturate in _mm_packs_epi32
+    const __m128 vbias = _mm_setr_ps(bias[0], bias[1], bias[2], bias[3]);
+    const __m128 vinv = _mm_setr_ps(inv[0], inv[1], inv[2], inv[3]);
+    const __m128 vshift = _mm_setr_ps(0.0f, 0.0f, 32768.0f, 32768.0f);
+    const __m128i vflip = _mm_setr_epi16(0, 0, (short)0x8000, (short)0x8000, 0, 0, (short)0x8000, (short)0x8000);
+    for (; i + 2 <= n; i += 2) {
+      __m128 a = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&src[i].x), vbias), vinv), vshift);
+      __m128 b = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&src[i + 1].x), vbias), vinv), vshift);
+      __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+      _mm_storeu_si128((__m128i *)&dst[i], _mm_xor_si128(packed, vflip));
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    float q[4];
+    const float *v = &src[i].x;
+    for (int c = 0; c < 4; c++) {
+      const float hiq = c < 2 ? 32767.0f : 65535.0f;
+      const float loq = c < 2 ? -32767.0f : 0.0f;
+      q[c] = floorf((v[c] - bias[c]) * inv[c] + 0.5f);
+      q[c] = q[c] < loq ? loq : (q[c] > hiq ? hiq : q[c]);
+    }
+    dst[i].x = (int16_t)q[0];
+    dst[i].y = (int16_t)q[1];
+    dst[i].u = (uint16_t)q[2];
+    dst[i].v = (uint16_t)q[3];
+  }
+}
+
+// NVG_COVERAGE_FILLS
+#define VKNVG_COVERAGE_BAND_HEIGHT 16
+#define VKNVG_COVERAGE_MAX_BANDS 64
+#define VKNVG_COVERAGE_MAX_BAND_EDGES 64 // the shader loops over the edges of a pixel's band
+
+// Number of outline points of a path. With antialiasing the fill vertices are inset by half a fringe,
+// so the outline is taken from the fringe strip instead.
+static int vknvg_outlineCount(const NVGpath *path) {
+  return path->nstroke > 0 ? path->nstroke / 2 : path->nfill;
+}
+
+// Outline point i of the path in pixels of the render target, the view starting at origin.
+static void vknvg_outlinePoint(const NVGpath *path, int i, float scale, VkOffset2D origin, float *pt) {
+  if (path->nstroke > 0) {
+    // The strip pairs are p + n*lw and p - n*rw with rw = fringe/2, lw = fringe*3/2 (or fringe/2 for a half
+    // fringe, whose inner u is 0.5), so p is a quarter (or half) of the way from the outer to the inner vertex.
+    const NVGvertex *a = &path->stroke[i * 2];
+    const NVGvertex *b = &path->stroke[i * 2 + 1];
+    float t = a->u > 0.25f ? 0.5f : 0.25f;
+    pt[0] = (b->x + (a->x - b->x) * t) * scale + origin.x;
+    pt[1] = (b->y + (a->y - b->y) * t) * scale + origin.y;
+  } else {
+    pt[0] = path->fill[i].x * scale + origin.x;
+    pt[1] = path->fill[i].y * scale + origin.y;
+  }
+}
+
+// Bins the edges of the paths into bands of pixel rows: one record (first edge, edge count) per band followed by
+// the edges (x0,y0,x1,y1), an edge being copied into every band it crosses. Fills coverage (see VKNVGfragUniforms).
+// Coordinates are those of gl_FragCoord. Returns false when a band gets more than VKNVG_COVERAGE_MAX_BAND_EDGES.
+static bool vknvg_coverageEdges(VKNVGcontext *vk, const NVGpath *paths, int npaths, float *coverage) {
+  const float scale = vk->devicePixelRatio;
+  const VkOffset2D origin = vk->viewScissor.offset;
+  int counts[VKNVG_COVERAGE_MAX_BANDS], first[VKNVG_COVERAGE_MAX_BANDS];
+  float ymin = FLT_MAX, ymax = -FLT_MAX, p0[2], p1[2];
+  int i, j, b, nbands, nedges = 0, offset = 0;
+  float *records = nullptr;
+
+  for (i = 0; i < npaths; i++) {
+    for (j = 0; j < vknvg_outlineCount(&paths[i]); j++) {
+      vknvg_outlinePoint(&paths[i], j, scale, origin, p0);
+      ymin = p0[1] < ymin ? p0[1] : ymin;
+      ymax = p0[1] > ymax ? p0[1] : ymax;
+    }
+  }
+  if (scale <= 0.0f || ymax <= ymin)
+    return false;
+  float top = floorf(ymin), height = ceilf(ymax) - top;
+  nbands = (int)ceilf(height / VKNVG_COVERAGE_BAND_HEIGHT);
+  nbands = nbands > VKNVG_COVERAGE_MAX_BANDS ? VKNVG_COVERAGE_MAX_BANDS : nbands;
+  float bandHeight = ceilf(height / nbands); // whole pixel rows, as the shader looks up the band of a row
+  memset(counts, 0, sizeof(counts));
+
+  // Two passes over the edges: count per band, then copy.
+  for (int pass = 0; pass < 2; pass++) {
+    for (i = 0; i < npaths; i++) {
+      int n = vknvg_outlineCount(&paths[i]);
+      if (n < 2)
+        continue;
+      vknvg_outlinePoint(&paths[i], n - 1, scale, origin, p0);
+      for (j = 0; j < n; j++, p0[0] = p1[0], p0[1] = p1[1]) {
+        vknvg_outlinePoint(&paths[i], j, scale, origin, p1);
+        if (p0[1] == p1[1])
+          continue; // horizontal edges cover nothing
+        int b0 = (int)(((p0[1] < p1[1] ? p0[1] : p1[1]) - top) / bandHeight);
+        int b1 = (int)(((p0[1] > p1[1] ? p0[1] : p1[1]) - top) / bandHeight);
+        b1 = b1 < nbands ? b1 : nbands - 1;
+        for (b = b0; b <= b1; b++) {
+          if (pass == 0) {
+            counts[b]++;
+          } else {
+            float *e = &records[(first[b] - offset + counts[b]++) * 4];
+            e[0] = p0[0];
+            e[1] = p0[1];
+            e[2] = p1[0];
+            e[3] = p1[1];
+          }
+        }
+      }
+    }
+    if (pass == 0) {
+      for (b = 0; b < nbands; b++) {
+        if (counts[b] > VKNVG_COVERAGE_MAX_BAND_EDGES)
+          return false;
+        nedges += counts[b];
+      }
+      offset = vknvg_allocCoverage(vk, nbands + nedges);
+      if (offset == -1)
+        return false;
+      records = (float *)vknvg_arenaPtr(&vk->coverage, offset);
+      coverage[0] = (float)offset;
+      coverage[1] = (float)nbands;
+      coverage[2] = top;
+      coverage[3] = bandHeight;
+      for (b = 0, j = offset + nbands; b < nbands; b++) {
+        float *rec = &records[b * 4];
+        rec[0] = (float)j;
+        rec[1] = (float)counts[b];
+        rec[2] = rec[3] = 0.0f;
+        first[b] = j;
+        j += counts[b];
+        counts[b] = 0;
+      }
+    }
+  }
+  return true;
+}
+
 static void vknvg_setUniforms(VKNVGcontext *vk, VkDescriptorSet descSet, int uniformOffset, int image) {
   VkDevice device = vk->createInfo.device;
 
-  VkWriteDescriptorSet writes[3] = {{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}};
+  VkWriteDescriptorSet writes[4] = {{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}};
 
   VkDescriptorBufferInfo vertUniformBufferInfo = {0};
-  vertUniformBufferInfo.buffer = vk->vertUniformBuffer.buffer;
+  vertUniformBufferInfo.buffer = vk->flush->vertUniformBuffer.buffer;
   vertUniformBufferInfo.offset = 0;
   vertUniformBufferInfo.range = sizeof(vk->view);
 
@@ -873,7 +2273,7 @@ static void vknvg_setUniforms(VKNVGcontext *vk, VkDescriptorSet descSet, int uni
   writes[0].dstBinding = 0;
 
   VkDescriptorBufferInfo uniform_buffer_info = {0};
-  uniform_buffer_info.buffer = vk->fragUniformBuffer.buffer;
+  uniform_buffer_info.buffer = vk->drawFragUniformBuffer;
   uniform_buffer_info.offset = uniformOffset;
   uniform_buffer_info.range = sizeof(VKNVGfragUniforms);
 
@@ -884,69 +2284,100 @@ static void vknvg_setUniforms(VKNVGcontext *vk, VkDescriptorSet descSet, int uni
   writes[1].dstBinding = 1;
 
   VkDescriptorImageInfo image_info;
-  if (image != 0) {
-    VKNVGtexture *tex = vknvg_findTexture(vk, image);
-
-    image_info.imageLayout = tex->imageLayout;
-    image_info.imageView = tex->view;
-    image_info.sampler = tex->sampler;
-
-    writes[2].dstSet = descSet;
-    writes[2].dstBinding = 2;
-    writes[2].descriptorCount = 1;
-    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writes[2].pImageInfo = &image_info;
-  } else {
-    //fixme
-    VKNVGtexture *tex = vknvg_findTexture(vk, 1);
-    image_info.imageLayout = tex->imageLayout;
-    image_info.imageView = tex->view;
-    image_info.sampler = tex->sampler;
+  VKNVGtexture *tex = image != 0 ? vknvg_findTexture(vk, image) : nullptr;
+  if (tex == nullptr) {
+    // no image, or it was deleted while the call was queued
+    tex = vknvg_findTexture(vk, vk->dummyImage);
+  }
+  image_info.imageLayout = tex->imageLayout;
+  image_info.imageView = tex->view;
+  image_info.sampler = tex->sampler;
+
+  writes[2].dstSet = descSet;
+  writes[2].dstBinding = 2;
+  writes[2].descriptorCount = 1;
+  writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[2].pImageInfo = &image_info;
+
+  VkDescriptorBufferInfo coverage_buffer_info = {vk->flush->coverageBuffer.buffer, 0, VK_WHOLE_SIZE};
+  writes[3].dstSet = descSet;
+  writes[3].dstBinding = 3;
+  writes[3].descriptorCount = 1;
+  writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[3].pBufferInfo = &coverage_buffer_info;
+
+  vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+}
+
+// NVG_BINDLESS_TEXTURES: set 0 for every call drawn from fragUniformBuffer, which selects its uniforms with a dynamic offset.
+static VkDescriptorSet vknvg_allocBindlessSet(VKNVGcontext *vk, VkBuffer fragUniformBuffer) {
+  if (fragUniformBuffer == VK_NULL_HANDLE)
+    return VK_NULL_HANDLE;
+  VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->flush->descPool, 1, &vk->cache->bindlessDescLayout};
+  VkDescriptorSet descSet;
+  NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(vk->createInfo.device, &alloc_info, &descSet));
 
-    writes[2].dstSet = descSet;
-    writes[2].dstBinding = 2;
-    writes[2].descriptorCount = 1;
-    writes[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writes[2].pImageInfo = &image_info;
+  VkDescriptorBufferInfo buffer_info[3] = {
+      {vk->flush->vertUniformBuffer.buffer, 0, sizeof(vk->view)},
+      {fragUniformBuffer, 0, sizeof(VKNVGfragUniforms)},
+      {vk->flush->coverageBuffer.buffer, 0, VK_WHOLE_SIZE},
+  };
+  const uint32_t bindings[3] = {0, 1, 3};
+  const VkDescriptorType types[3] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+  VkWriteDescriptorSet writes[3] = {{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}, {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET}};
+  for (int i = 0; i < 3; i++) {
+    writes[i].dstSet = descSet;
+    writes[i].dstBinding = bindings[i];
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = types[i];
+    writes[i].pBufferInfo = &buffer_info[i];
   }
+  vkUpdateDescriptorSets(vk->createInfo.device, 3, writes, 0, nullptr);
+  return descSet;
+}
 
-  vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+// Binds the uniforms and image of a call. Without NVG_BINDLESS_TEXTURES, every call gets a descriptor set of its own.
+static void vknvg_bindUniforms(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, const VKNVGcall *call) {
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    VkDescriptorSet sets[2] = {vk->drawDescSet, vk->textureDescSet};
+    uint32_t offset = (uint32_t)call->uniformOffset;
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->cache->bindlessPipelineLayout, 0, 2, sets, 1, &offset);
+    return;
+  }
+  VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->flush->descPool, 1, &vk->cache->descLayout};
+  VkDescriptorSet descSet;
+  NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(vk->createInfo.device, &alloc_info, &descSet));
+  vknvg_setUniforms(vk, descSet, call->uniformOffset, call->image);
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->cache->pipelineLayout, 0, 1, &descSet, 0, nullptr);
 }
 
 static void vknvg_fill(VKNVGcontext *vk, VKNVGcall *call) {
-  VKNVGpath *paths = &vk->paths[call->pathOffset];
+  VKNVGpath *paths = vknvg_callPaths(vk, call);
   int i, npaths = call->pathCount;
 
-  VkDevice device = vk->createInfo.device;
   VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
 
   VKNVGCreatePipelineKey pipelinekey = {0};
   pipelinekey.compositOperation = call->compositOperation;
   pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
   pipelinekey.stencilFill = true;
-  pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
-
-  vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
+  pipelinekey.shaderType = NSVG_SHADER_SIMPLE;
 
-  VkDescriptorSetAllocateInfo alloc_info[1] = {
-      {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->descPool, 1, &vk->descLayout},
-  };
-  VkDescriptorSet descSet;
-  NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, alloc_info, &descSet));
-  vknvg_setUniforms(vk, descSet, call->uniformOffset, call->image); //fixme
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->pipelineLayout, 0, 1, &descSet, 0, nullptr);
+  if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+    return;
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->cache->stencilPipelineLayout, 0, 1, &vk->stencilDescSet, 0, nullptr);
 
   for (i = 0; i < npaths; i++) {
-    const VkDeviceSize offsets[1] = {paths[i].fillOffset * sizeof(NVGvertex)};
-    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+    const VkDeviceSize offsets[1] = {paths[i].fillOffset * vk->vertexSize};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
     vkCmdDraw(cmdBuffer, paths[i].fillCount, 1, 0, 0);
   }
 
-  VkDescriptorSet descSet2;
-  NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, alloc_info, &descSet2));
-  vknvg_setUniforms(vk, descSet2, call->uniformOffset + vk->fragSize, call->image);
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->pipelineLayout, 0, 1, &descSet2, 0, nullptr);
+  vknvg_bindUniforms(vk, cmdBuffer, call);
 
+  pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
+  pipelinekey.shaderType = call->shaderType;
+  pipelinekey.texType = call->texType;
   if (vk->flags & NVG_ANTIALIAS) {
 
     pipelinekey.compositOperation = call->compositOperation;
@@ -954,11 +2385,11 @@ static void vknvg_fill(VKNVGcontext *vk, VKNVGcall *call) {
     pipelinekey.stencilFill = false;
     pipelinekey.stencilTest = true;
     pipelinekey.edgeAA = true;
-    vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
+    VkPipeline fringes = vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
     // Draw fringes
-    for (int i = 0; i < npaths; ++i) {
-      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * sizeof(NVGvertex)};
-      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+    for (int i = 0; i < npaths && fringes != VK_NULL_HANDLE; ++i) {
+      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * vk->vertexSize};
+      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
       vkCmdDraw(cmdBuffer, paths[i].strokeCount, 1, 0, 0);
     }
   }
@@ -968,100 +2399,127 @@ static void vknvg_fill(VKNVGcontext *vk, VKNVGcall *call) {
   pipelinekey.stencilFill = false;
   pipelinekey.stencilTest = true;
   pipelinekey.edgeAA = false;
-  vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
+  if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+    return;
 
-  const VkDeviceSize offsets[1] = {call->triangleOffset * sizeof(NVGvertex)};
-  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+  const VkDeviceSize offsets[1] = {call->triangleOffset * vk->vertexSize};
+  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
   vkCmdDraw(cmdBuffer, call->triangleCount, 1, 0, 0);
 }
 
 static void vknvg_convexFill(VKNVGcontext *vk, VKNVGcall *call) {
-  VKNVGpath *paths = &vk->paths[call->pathOffset];
+  VKNVGpath *paths = vknvg_callPaths(vk, call);
   int npaths = call->pathCount;
 
-  VkDevice device = vk->createInfo.device;
+  // the interior of an opaque call has been drawn by vknvg_opaqueFill
+  if (call->opaque && !(vk->flags & NVG_ANTIALIAS)) {
+    return;
+  }
+
   VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
 
   VKNVGCreatePipelineKey pipelinekey = {0};
   pipelinekey.compositOperation = call->compositOperation;
   pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
   pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
+  pipelinekey.shaderType = call->shaderType;
+  pipelinekey.texType = call->texType;
 
-  vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
-
-  VkDescriptorSetAllocateInfo alloc_info[1] = {
-      {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->descPool, 1, &vk->descLayout},
-  };
-  VkDescriptorSet descSet;
-  NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, alloc_info, &descSet));
-  vknvg_setUniforms(vk, descSet, call->uniformOffset, call->image);
+  VkPipeline interior = vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
 
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->pipelineLayout, 0, 1, &descSet, 0, nullptr);
+  vknvg_bindUniforms(vk, cmdBuffer, call);
 
-  for (int i = 0; i < npaths; ++i) {
-    const VkDeviceSize offsets[1] = {paths[i].fillOffset * sizeof(NVGvertex)};
-    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+  for (int i = 0; i < npaths && !call->opaque && interior != VK_NULL_HANDLE; ++i) {
+    const VkDeviceSize offsets[1] = {paths[i].fillOffset * vk->vertexSize};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
     vkCmdDraw(cmdBuffer, paths[i].fillCount, 1, 0, 0);
   }
   if (vk->flags & NVG_ANTIALIAS) {
     pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
-    vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
+    VkPipeline fringes = vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
 
     // Draw fringes
-    for (int i = 0; i < npaths; ++i) {
-      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * sizeof(NVGvertex)};
-      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+    for (int i = 0; i < npaths && fringes != VK_NULL_HANDLE; ++i) {
+      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * vk->vertexSize};
+      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
       vkCmdDraw(cmdBuffer, paths[i].strokeCount, 1, 0, 0);
     }
   }
 }
 
+// NVG_DEPTH_OVERDRAW opaque pass: the interior of an opaque convex fill, without blending and writing the call's depth.
+static void vknvg_opaqueFill(VKNVGcontext *vk, VKNVGcall *call) {
+  VKNVGpath *paths = vknvg_callPaths(vk, call);
+  int npaths = call->pathCount;
+
+  VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
+
+  VKNVGCreatePipelineKey pipelinekey = {0};
+  pipelinekey.compositOperation = call->compositOperation;
+  pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN;
+  pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
+  pipelinekey.depthWrite = true;
+  pipelinekey.shaderType = call->shaderType;
+  pipelinekey.texType = call->texType;
+
+  if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+    return;
+
+  vknvg_bindUniforms(vk, cmdBuffer, call);
+
+  for (int i = 0; i < npaths; ++i) {
+    const VkDeviceSize offsets[1] = {paths[i].fillOffset * vk->vertexSize};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
+    vkCmdDraw(cmdBuffer, paths[i].fillCount, 1, 0, 0);
+  }
+}
+
 static void vknvg_stroke(VKNVGcontext *vk, VKNVGcall *call) {
-  VkDevice device = vk->createInfo.device;
   VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
 
-  VKNVGpath *paths = &vk->paths[call->pathOffset];
+  VKNVGpath *paths = vknvg_callPaths(vk, call);
   int npaths = call->pathCount;
 
   if (vk->flags & NVG_STENCIL_STROKES) {
 
-    VkDescriptorSetAllocateInfo alloc_info[1] = {
-        {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->descPool, 1, &vk->descLayout},
-    };
-    VkDescriptorSet descSet;
-    NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, alloc_info, &descSet));
-    vknvg_setUniforms(vk, descSet, call->uniformOffset, call->image);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->pipelineLayout, 0, 1, &descSet, 0, nullptr);
+    vknvg_bindUniforms(vk, cmdBuffer, call);
     VKNVGCreatePipelineKey pipelinekey = {0};
     pipelinekey.compositOperation = call->compositOperation;
     pipelinekey.stencilFill = false;
     pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
     pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
-    vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
+    pipelinekey.shaderType = call->shaderType;
+    pipelinekey.texType = call->texType;
+    if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+      return;
 
     for (int i = 0; i < npaths; ++i) {
-      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * sizeof(NVGvertex)};
-      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * vk->vertexSize};
+      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
       vkCmdDraw(cmdBuffer, paths[i].strokeCount, 1, 0, 0);
     }
 
     pipelinekey.stencilFill = false;
     pipelinekey.stencilTest = true;
     pipelinekey.edgeAA = true;
-    vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
-    for (int i = 0; i < npaths; ++i) {
-      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * sizeof(NVGvertex)};
-      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+    VkPipeline fringes = vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
+    for (int i = 0; i < npaths && fringes != VK_NULL_HANDLE; ++i) {
+      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * vk->vertexSize};
+      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
       vkCmdDraw(cmdBuffer, paths[i].strokeCount, 1, 0, 0);
     }
 
-    pipelinekey.stencilFill = true;
-    pipelinekey.stencilTest = true;
-    pipelinekey.edgeAAShader = false;
+    // Clear stencil buffer
+    pipelinekey.stencilTest = false;
+    pipelinekey.stencilClear = true;
     pipelinekey.edgeAA = false;
+    pipelinekey.shaderType = NSVG_SHADER_SIMPLE;
+    if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+      return;
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->cache->stencilPipelineLayout, 0, 1, &vk->stencilDescSet, 0, nullptr);
     for (int i = 0; i < npaths; ++i) {
-      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * sizeof(NVGvertex)};
-      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * vk->vertexSize};
+      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
       vkCmdDraw(cmdBuffer, paths[i].strokeCount, 1, 0, 0);
     }
   } else {
@@ -1071,20 +2529,17 @@ static void vknvg_stroke(VKNVGcontext *vk, VKNVGcall *call) {
     pipelinekey.stencilFill = false;
     pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
     pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
+    pipelinekey.shaderType = call->shaderType;
+    pipelinekey.texType = call->texType;
 
-    vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
-    VkDescriptorSetAllocateInfo alloc_info[1] = {
-        {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->descPool, 1, &vk->descLayout},
-    };
-    VkDescriptorSet descSet;
-    NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, alloc_info, &descSet));
-    vknvg_setUniforms(vk, descSet, call->uniformOffset, call->image);
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->pipelineLayout, 0, 1, &descSet, 0, nullptr);
+    if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+      return;
+    vknvg_bindUniforms(vk, cmdBuffer, call);
     // Draw Strokes
 
     for (int i = 0; i < npaths; ++i) {
-      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * sizeof(NVGvertex)};
-      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+      const VkDeviceSize offsets[1] = {paths[i].strokeOffset * vk->vertexSize};
+      vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
       vkCmdDraw(cmdBuffer, paths[i].strokeCount, 1, 0, 0);
     }
   }
@@ -1094,7 +2549,6 @@ static void vknvg_triangles(VKNVGcontext *vk, VKNVGcall *call) {
   if (call->triangleCount == 0) {
     return;
   }
-  VkDevice device = vk->createInfo.device;
   VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
 
   VKNVGCreatePipelineKey pipelinekey = {0};
@@ -1102,75 +2556,735 @@ static void vknvg_triangles(VKNVGcontext *vk, VKNVGcall *call) {
   pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   pipelinekey.stencilFill = false;
   pipelinekey.edgeAAShader = vk->flags & NVG_ANTIALIAS;
+  pipelinekey.shaderType = call->shaderType;
+  pipelinekey.texType = call->texType;
 
-  vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey);
-  VkDescriptorSetAllocateInfo alloc_info[1] = {
-      {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->descPool, 1, &vk->descLayout},
-  };
-  VkDescriptorSet descSet;
-  NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, alloc_info, &descSet));
-  vknvg_setUniforms(vk, descSet, call->uniformOffset, call->image);
-  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vk->pipelineLayout, 0, 1, &descSet, 0, nullptr);
+  if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+    return;
+  vknvg_bindUniforms(vk, cmdBuffer, call);
 
-  const VkDeviceSize offsets[1] = {call->triangleOffset * sizeof(NVGvertex)};
-  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->vertexBuffer.buffer, offsets);
+  const VkDeviceSize offsets[1] = {call->triangleOffset * vk->vertexSize};
+  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
 
   vkCmdDraw(cmdBuffer, call->triangleCount, 1, 0, 0);
 }
-///==================================================================================================================
-static int vknvg_renderCreate(void *uptr) {
-  VKNVGcontext *vk = (VKNVGcontext *)uptr;
-  VkDevice device = vk->createInfo.device;
-  VkRenderPass renderpass = vk->createInfo.renderpass;
-  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
 
-  vkGetPhysicalDeviceMemoryProperties(vk->createInfo.gpu, &vk->memoryProperties);
-  vkGetPhysicalDeviceProperties(vk->createInfo.gpu, &vk->gpuProperties);
-
-  static const unsigned char fillVertShader[] = {
-#include "shader/fill_vert_shader_hex.txt"
-  };
+static void vknvg_text(VKNVGcontext *vk, VKNVGcall *call) {
+  VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
 
-  static const unsigned char fillFragShader[] = {
-#include "shader/fill_frag_shader_hex.txt"
-  };
-  static const unsigned char fillFragShaderAA[] = {
-#include "shader/fill_edge_aa_frag_shader_hex.txt"
+  VKNVGCreatePipelineKey pipelinekey = {0};
+  pipelinekey.compositOperation = call->compositOperation;
+  pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+  pipelinekey.text = true;
+  pipelinekey.shaderType = call->shaderType;
+  pipelinekey.texType = call->texType;
+
+  if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+    return;
+  vknvg_bindUniforms(vk, cmdBuffer, call);
+
+  const VkDeviceSize offsets[1] = {call->glyphOffset * sizeof(VKNVGglyph)};
+  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawGlyphBuffer, offsets);
+  vkCmdDraw(cmdBuffer, 4, call->glyphCount, 0, 0);
+}
+
+static void vknvg_coverageFill(VKNVGcontext *vk, VKNVGcall *call) {
+  VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
+
+  VKNVGCreatePipelineKey pipelinekey = {0};
+  pipelinekey.compositOperation = call->compositOperation;
+  pipelinekey.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+  pipelinekey.coverage = true;
+  pipelinekey.shaderType = call->shaderType;
+  pipelinekey.texType = call->texType;
+
+  if (vknvg_bindPipeline(vk, cmdBuffer, &pipelinekey) == VK_NULL_HANDLE)
+    return;
+  vknvg_bindUniforms(vk, cmdBuffer, call);
+
+  // Bounding box quad, the coverage comes from the storage buffer
+  const VkDeviceSize offsets[1] = {call->triangleOffset * vk->vertexSize};
+  vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vk->drawVertexBuffer, offsets);
+  vkCmdDraw(cmdBuffer, call->triangleCount, 1, 0, 0);
+}
+
+static void vknvg_pushConstants(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, const float *xform, float alpha) {
+  VKNVGpushConstants pc;
+  memcpy(pc.xform, xform, sizeof(pc.xform));
+  pc.alpha = alpha;
+  vkCmdPushConstants(cmdBuffer, vk->cache->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, offsetof(VKNVGpushConstants, depth), &pc);
+}
+
+static void vknvg_pushDepth(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, float depth) {
+  vkCmdPushConstants(cmdBuffer, vk->cache->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(VKNVGpushConstants, depth), sizeof(float), &depth);
+}
+
+// NVG_DEPTH_OVERDRAW: later calls are nearer, all of them in front of the cleared depth of 1.0
+static float vknvg_callDepth(int i, int ncalls) {
+  return 1.0f - (float)(i + 1) / (float)(ncalls + 1);
+}
+
+static void vknvg_pushDequant(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, const float *posDequant, const float *uvDequant) {
+  float dequant[8];
+  memcpy(dequant, posDequant, sizeof(float) * 4);
+  memcpy(dequant + 4, uvDequant, sizeof(float) * 4);
+  vkCmdPushConstants(cmdBuffer, vk->cache->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, offsetof(VKNVGpushConstants, posDequant), sizeof(dequant), dequant);
+}
+
+static void vknvg_displayList(VKNVGcontext *vk, VKNVGcall *call);
+
+static void vknvg_setScissor(VKNVGcontext *vk, VkCommandBuffer cmdBuffer, const VkRect2D *rect) {
+  if (memcmp(rect, &vk->currentScissor, sizeof(VkRect2D)) != 0) {
+    vkCmdSetScissor(cmdBuffer, 0, 1, rect);
+    vk->currentScissor = *rect;
+  }
+}
+
+static void vknvg_drawCall(VKNVGcontext *vk, VKNVGcall *call) {
+  if (call->type != VKNVG_DISPLAYLIST && !vk->replaying) {
+    vknvg_setScissor(vk, vk->createInfo.cmdBuffer, call->scissored ? &call->scissorRect : &vk->viewScissor);
+  }
+  if ((vk->flags & NVG_PACKED_VERTICES) && call->type != VKNVG_DISPLAYLIST) {
+    vknvg_pushDequant(vk, vk->createInfo.cmdBuffer, call->posDequant, call->uvDequant);
+  }
+  if (call->type == VKNVG_FILL)
+    vknvg_fill(vk, call);
+  else if (call->type == VKNVG_CONVEXFILL)
+    vknvg_convexFill(vk, call);
+  else if (call->type == VKNVG_COVERAGEFILL)
+    vknvg_coverageFill(vk, call);
+  else if (call->type == VKNVG_STROKE)
+    vknvg_stroke(vk, call);
+  else if (call->type == VKNVG_TRIANGLES)
+    vknvg_triangles(vk, call);
+  else if (call->type == VKNVG_TEXT)
+    vknvg_text(vk, call);
+  else if (call->type == VKNVG_DISPLAYLIST)
+    vknvg_displayList(vk, call);
+}
+
+static void vknvg_displayList(VKNVGcontext *vk, VKNVGcall *call) {
+  VKNVGdisplayList *list = call->displayList;
+  VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
+  static const float identity[6] = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+
+  vk->drawPaths = list->paths;
+  vk->drawVertexBuffer = list->vertexBuffer.buffer;
+  vk->drawFragUniformBuffer = list->fragUniformBuffer.buffer;
+  vk->drawGlyphBuffer = list->glyphBuffer.buffer;
+  VkDescriptorSet frameDescSet = vk->drawDescSet;
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    vk->drawDescSet = vknvg_allocBindlessSet(vk, list->fragUniformBuffer.buffer);
+  }
+  vknvg_pushConstants(vk, cmdBuffer, call->xform, call->alpha);
+  vknvg_setScissor(vk, cmdBuffer, &vk->viewScissor);
+
+  vk->replaying = true;
+  for (int i = 0; i < list->ncalls; i++) {
+    vknvg_drawCall(vk, &list->calls[i]);
+  }
+  vk->replaying = false;
+
+  vk->drawPaths = nullptr;
+  vk->drawVertexBuffer = vk->flush->vertexBuffer.buffer;
+  vk->drawFragUniformBuffer = vk->flush->fragUniformBuffer.buffer;
+  vk->drawGlyphBuffer = vk->flush->glyphBuffer.buffer;
+  vk->drawDescSet = frameDescSet;
+  vknvg_pushConstants(vk, cmdBuffer, identity, 1.0f);
+}
+
+static VkSampler vknvg_createSampler(VkDevice device, int samplerBits, const VkAllocationCallbacks *allocator) {
+  VkSamplerCreateInfo samplerCreateInfo = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  if (samplerBits & VKNVG_SAMPLER_NEAREST) {
+    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+  } else {
+    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  }
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerCreateInfo.addressModeU = (samplerBits & VKNVG_SAMPLER_REPEATX) ? VK_SAMPLER_ADDRESS_MODE_REPEAT : VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = (samplerBits & VKNVG_SAMPLER_REPEATY) ? VK_SAMPLER_ADDRESS_MODE_REPEAT : VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.mipLodBias = 0.0;
+  samplerCreateInfo.anisotropyEnable = VK_FALSE;
+  samplerCreateInfo.maxAnisotropy = 1;
+  samplerCreateInfo.compareEnable = VK_FALSE;
+  samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+  samplerCreateInfo.minLod = 0.0;
+  samplerCreateInfo.maxLod = 0.0;
+  if (samplerBits & VKNVG_SAMPLER_MIPMAP) {
+    samplerCreateInfo.mipmapMode = (samplerBits & VKNVG_SAMPLER_NEAREST) ? VK_SAMPLER_MIPMAP_MODE_NEAREST : VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+  }
+  samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+
+  VkSampler sampler;
+  NVGVK_CHECK_RESULT(vkCreateSampler(device, &samplerCreateInfo, allocator, &sampler));
+  return sampler;
+}
+
+static VkSampler vknvg_getSampler(VKNVGdeviceCache *cache, int imageFlags) {
+  int samplerBits = 0;
+  if (imageFlags & NVG_IMAGE_NEAREST)
+    samplerBits |= VKNVG_SAMPLER_NEAREST;
+  if (imageFlags & NVG_IMAGE_REPEATX)
+    samplerBits |= VKNVG_SAMPLER_REPEATX;
+  if (imageFlags & NVG_IMAGE_REPEATY)
+    samplerBits |= VKNVG_SAMPLER_REPEATY;
+  if (imageFlags & NVG_IMAGE_GENERATE_MIPMAPS)
+    samplerBits |= VKNVG_SAMPLER_MIPMAP;
+  return cache->samplers[samplerBits];
+}
+
+static void vknvg_retainDeviceCache(VKNVGdeviceCache *cache) {
+  vknvg_mutexLock(&cache->mutex);
+  cache->refCount++;
+  vknvg_mutexUnlock(&cache->mutex);
+}
+
+// Creates the NVG_BINDLESS_TEXTURES objects of the cache, which need the descriptor indexing features.
+static void vknvg_initBindless(VKNVGdeviceCache *cache) {
+  static const unsigned char fillBindlessFragShader[] = {
+#include "shader/fill_bindless_frag_shader_hex.txt"
   };
+  VkDevice device = cache->device;
+  const VkAllocationCallbacks *allocator = cache->allocator;
+
+  vknvg_mutexLock(&cache->mutex);
+  if (cache->bindlessPipelineLayout == VK_NULL_HANDLE) {
+    cache->fillBindlessFragShader = vknvg_createShaderModule(device, fillBindlessFragShader, sizeof(fillBindlessFragShader), allocator);
+    cache->bindlessDescLayout = vknvg_createBindlessDescriptorSetLayout(device, allocator);
+    cache->textureDescLayout = vknvg_createTextureDescriptorSetLayout(device, allocator);
+    VkDescriptorSetLayout layouts[2] = {cache->bindlessDescLayout, cache->textureDescLayout};
+    cache->bindlessPipelineLayout = vknvg_createPipelineLayout(device, 2, layouts, allocator);
+  }
+  vknvg_mutexUnlock(&cache->mutex);
+}
+
+static void vknvg_releaseDeviceCache(VKNVGdeviceCache *cache) {
+  vknvg_mutexLock(&cache->mutex);
+  int refCount = --cache->refCount;
+  vknvg_mutexUnlock(&cache->mutex);
+  if (refCount > 0) {
+    return;
+  }
+
+  VkDevice device = cache->device;
+  const VkAllocationCallbacks *allocator = cache->allocator;
+
+  for (int i = 0; i < cache->npipelines; i++) {
+    vkDestroyPipeline(device, cache->pipelines[i].pipeline, allocator);
+  }
+  for (int i = 0; i < VKNVG_SAMPLER_COUNT; i++) {
+    vkDestroySampler(device, cache->samplers[i], allocator);
+  }
+  for (int i = 0; i < cache->nframebufferPasses; i++) {
+    vkDestroyRenderPass(device, cache->framebufferPasses[i].renderpass, allocator);
+  }
+
+  vkDestroyShaderModule(device, cache->fillVertShader, allocator);
+  vkDestroyShaderModule(device, cache->fillFragShader, allocator);
+  vkDestroyShaderModule(device, cache->stencilFragShader, allocator);
+  vkDestroyShaderModule(device, cache->textVertShader, allocator);
+
+  vkDestroyDescriptorSetLayout(device, cache->descLayout, allocator);
+  vkDestroyPipelineLayout(device, cache->pipelineLayout, allocator);
+  vkDestroyDescriptorSetLayout(device, cache->stencilDescLayout, allocator);
+  vkDestroyPipelineLayout(device, cache->stencilPipelineLayout, allocator);
+  vkDestroyShaderModule(device, cache->fillBindlessFragShader, allocator);
+  vkDestroyDescriptorSetLayout(device, cache->bindlessDescLayout, allocator);
+  vkDestroyDescriptorSetLayout(device, cache->textureDescLayout, allocator);
+  vkDestroyPipelineLayout(device, cache->bindlessPipelineLayout, allocator);
+
+  vknvg_mutexDestroy(&cache->mutex);
+  free(cache->pipelines);
+  free(cache);
+}
+
+static VkResult vknvg_createImage(VKNVGcontext *vk, const VkImageCreateInfo *image_createInfo, VkMemoryPropertyFlags memory_type, VkImage *image, VkDeviceMemory *mem) {
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+
+  VkResult res = vkCreateImage(device, image_createInfo, allocator, image);
+  if (res != VK_SUCCESS) {
+    *image = VK_NULL_HANDLE;
+    return res;
+  }
+
+  VkMemoryRequirements mem_reqs;
+  vkGetImageMemoryRequirements(device, *image, &mem_reqs);
+
+  VkMemoryAllocateInfo mem_alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  mem_alloc.allocationSize = mem_reqs.size;
+  res = vknvg_memory_type_from_properties(vk->memoryProperties, mem_reqs.memoryTypeBits, memory_type, &mem_alloc.memoryTypeIndex);
+  if (res == VK_SUCCESS)
+    res = vkAllocateMemory(device, &mem_alloc, allocator, mem);
+  if (res != VK_SUCCESS) {
+    vkDestroyImage(device, *image, allocator);
+    *image = VK_NULL_HANDLE;
+    return res;
+  }
+  res = vkBindImageMemory(device, *image, *mem, 0);
+  if (res != VK_SUCCESS) {
+    vkFreeMemory(device, *mem, allocator);
+    vkDestroyImage(device, *image, allocator);
+    *mem = VK_NULL_HANDLE;
+    *image = VK_NULL_HANDLE;
+  }
+  return res;
+}
+
+static VkImageView vknvg_createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectMask, const VkAllocationCallbacks *allocator) {
+  VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  view_info.image = image;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.components.r = VK_COMPONENT_SWIZZLE_R;
+  view_info.components.g = VK_COMPONENT_SWIZZLE_G;
+  view_info.components.b = VK_COMPONENT_SWIZZLE_B;
+  view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+  view_info.subresourceRange.aspectMask = aspectMask;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+
+  VkImageView view;
+  if (vkCreateImageView(device, &view_info, allocator, &view) != VK_SUCCESS)
+    return VK_NULL_HANDLE;
+  return view;
+}
+
+static VkFormat vknvg_findStencilFormat(VkPhysicalDevice gpu, bool needDepth) {
+  const VkFormat candidates[] = {VK_FORMAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D16_UNORM_S8_UINT};
+  for (size_t i = needDepth ? 1 : 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(gpu, candidates[i], &props);
+    if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return candidates[i];
+    }
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+
+static VkRenderPass vknvg_createFramebufferRenderPass(VkDevice device, VkFormat colorFormat, VkFormat stencilFormat, const VkAllocationCallbacks *allocator) {
+  VkAttachmentDescription attachments[2] = {{0}};
+  attachments[0].format = colorFormat;
+  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  attachments[1].format = stencilFormat;
+  attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // NVG_DEPTH_OVERDRAW
+  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference color_reference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference stencil_reference = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass = {0};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &color_reference;
+  subpass.pDepthStencilAttachment = &stencil_reference;
+
+  // The previous frame may still be sampling the color image, and the result is sampled after the pass.
+  VkSubpassDependency dependencies[2] = {{0}};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo rp_info = {VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+  rp_info.attachmentCount = 2;
+  rp_info.pAttachments = attachments;
+  rp_info.subpassCount = 1;
+  rp_info.pSubpasses = &subpass;
+  rp_info.dependencyCount = 2;
+  rp_info.pDependencies = dependencies;
+
+  VkRenderPass renderpass;
+  if (vkCreateRenderPass(device, &rp_info, allocator, &renderpass) != VK_SUCCESS)
+    return VK_NULL_HANDLE;
+  return renderpass;
+}
+
+// The render pass of the cache for framebuffers with these formats, created on first use.
+static VkRenderPass vknvg_getFramebufferRenderPass(VKNVGdeviceCache *cache, VkFormat colorFormat, VkFormat stencilFormat) {
+  VkRenderPass ret = VK_NULL_HANDLE;
+  vknvg_mutexLock(&cache->mutex);
+  for (int i = 0; i < cache->nframebufferPasses; i++) {
+    const VKNVGframebufferPass *pass = &cache->framebufferPasses[i];
+    if (pass->colorFormat == colorFormat && pass->stencilFormat == stencilFormat) {
+      ret = pass->renderpass;
+      break;
+    }
+  }
+  if (ret == VK_NULL_HANDLE && cache->nframebufferPasses < VKNVG_MAX_FRAMEBUFFER_PASSES) {
+    ret = vknvg_createFramebufferRenderPass(cache->device, colorFormat, stencilFormat, cache->allocator);
+    if (ret != VK_NULL_HANDLE) {
+      VKNVGframebufferPass pass = {colorFormat, stencilFormat, ret};
+      cache->framebufferPasses[cache->nframebufferPasses++] = pass;
+    }
+  }
+  vknvg_mutexUnlock(&cache->mutex);
+  return ret;
+}
+
+// One shot command buffer on createInfo.queue, for uploads outside of the frame's command buffer.
+static VkCommandBuffer vknvg_beginUpload(VKNVGcontext *vk) {
+  VkDevice device = vk->createInfo.device;
+
+  if (vk->uploadCmdPool == VK_NULL_HANDLE) {
+    VkCommandPoolCreateInfo pool_info = {VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    pool_info.queueFamilyIndex = vk->createInfo.queueFamilyIndex;
+    NVGVK_CHECK_RESULT(vkCreateCommandPool(device, &pool_info, vk->createInfo.allocator, &vk->uploadCmdPool));
+  }
+
+  VkCommandBufferAllocateInfo cmd_alloc = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  cmd_alloc.commandPool = vk->uploadCmdPool;
+  cmd_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmd_alloc.commandBufferCount = 1;
+  VkCommandBuffer cmdBuffer;
+  NVGVK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmd_alloc, &cmdBuffer));
+
+  VkCommandBufferBeginInfo begin_info = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  NVGVK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &begin_info));
+  return cmdBuffer;
+}
+
+static void vknvg_endUpload(VKNVGcontext *vk, VkCommandBuffer cmdBuffer) {
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+
+  NVGVK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+
+  VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  VkFence fence;
+  NVGVK_CHECK_RESULT(vkCreateFence(device, &fence_info, allocator, &fence));
+
+  VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmdBuffer;
+  NVGVK_CHECK_RESULT(vkQueueSubmit(vk->createInfo.queue, 1, &submit_info, fence));
+  NVGVK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+
+  vkDestroyFence(device, fence, allocator);
+  vkFreeCommandBuffers(device, vk->uploadCmdPool, 1, &cmdBuffer);
+}
+
+// Frees the command buffers of finished uploads, waiting for all of them when wait is set.
+static void vknvg_retireUploads(VKNVGcontext *vk, bool wait) {
+  VkDevice device = vk->createInfo.device;
+  int i, n = 0;
+  for (i = 0; i < vk->nuploads; i++) {
+    VKNVGupload *upload = &vk->uploads[i];
+    if (wait) {
+      vkWaitForFences(device, 1, &upload->fence, VK_TRUE, UINT64_MAX);
+    } else if (vkGetFenceStatus(device, upload->fence) != VK_SUCCESS) {
+      vk->uploads[n++] = *upload;
+      continue;
+    }
+    vkDestroyFence(device, upload->fence, vk->createInfo.allocator);
+    vkFreeCommandBuffers(device, vk->uploadCmdPool, 1, &upload->cmdBuffer);
+  }
+  vk->nuploads = n;
+}
+
+// Like vknvg_endUpload without the CPU wait: the commands are ordered before what is submitted to createInfo.queue
+// afterwards, and the command buffer is freed by vknvg_retireUploads.
+static void vknvg_submitUpload(VKNVGcontext *vk, VkCommandBuffer cmdBuffer) {
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+
+  vknvg_retireUploads(vk, false);
+  if (vk->nuploads + 1 > vk->cuploads) {
+    int cuploads = vknvg_maxi(vk->nuploads + 1, 4) + vk->cuploads / 2; // 1.5x Overallocate
+    VKNVGupload *uploads = (VKNVGupload *)realloc(vk->uploads, sizeof(VKNVGupload) * cuploads);
+    if (uploads == nullptr) {
+      vknvg_endUpload(vk, cmdBuffer);
+      return;
+    }
+    vk->uploads = uploads;
+    vk->cuploads = cuploads;
+  }
+
+  NVGVK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffer));
+  VKNVGupload upload = {cmdBuffer, VK_NULL_HANDLE};
+  VkFenceCreateInfo fence_info = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  NVGVK_CHECK_RESULT(vkCreateFence(device, &fence_info, allocator, &upload.fence));
+
+  VkSubmitInfo submit_info = {VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmdBuffer;
+  NVGVK_CHECK_RESULT(vkQueueSubmit(vk->createInfo.queue, 1, &submit_info, upload.fence));
+  vk->uploads[vk->nuploads++] = upload;
+}
+
+static void vknvg_imageBarrier(VkCommandBuffer cmdBuffer, VkImage image, uint32_t levels, VkImageLayout oldLayout, VkImageLayout newLayout,
+                               VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+  VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = levels;
+  barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// Imports [data, data + size) of the caller's memory, see nvgVkCreateImageFromHostMemory.
+static VkResult vknvg_importHostMemory(VKNVGcontext *vk, void *data, VkDeviceSize size, uint32_t typeBits, VkDeviceMemory *mem) {
+  VkImportMemoryHostPointerInfoEXT import_info = {VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT};
+  import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  import_info.pHostPointer = data;
+  VkMemoryAllocateInfo mem_alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  mem_alloc.pNext = &import_info;
+  mem_alloc.allocationSize = size;
+  // never flushed, host writes have to be visible at the next submission
+  VkResult res = vknvg_memory_type_from_properties(vk->memoryProperties, typeBits, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &mem_alloc.memoryTypeIndex);
+  if (res == VK_SUCCESS)
+    res = vkAllocateMemory(vk->createInfo.device, &mem_alloc, vk->createInfo.allocator, mem);
+  if (res != VK_SUCCESS)
+    *mem = VK_NULL_HANDLE;
+  return res;
+}
+
+// Whether caller memory can back an RGBA image of that tiling and size, see nvgVkCreateImageFromHostMemory.
+static bool vknvg_hostImageImportable(VKNVGcontext *vk, VkImageTiling tiling, VkImageUsageFlags usage, int w, int h) {
+  VkPhysicalDeviceExternalImageFormatInfo external_info = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO};
+  external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  VkPhysicalDeviceImageFormatInfo2 format_info = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2};
+  format_info.pNext = &external_info;
+  format_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+  format_info.type = VK_IMAGE_TYPE_2D;
+  format_info.tiling = tiling;
+  format_info.usage = usage;
+  VkExternalImageFormatProperties external_props = {VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES};
+  VkImageFormatProperties2 props = {VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2};
+  props.pNext = &external_props;
+  if (vkGetPhysicalDeviceImageFormatProperties2(vk->createInfo.gpu, &format_info, &props) != VK_SUCCESS)
+    return false;
+  return (external_props.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT) &&
+         props.imageFormatProperties.maxExtent.width >= (uint32_t)w && props.imageFormatProperties.maxExtent.height >= (uint32_t)h;
+}
+static bool vknvg_hostBufferImportable(VKNVGcontext *vk, VkBufferUsageFlags usage) {
+  VkPhysicalDeviceExternalBufferInfo buffer_info = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_BUFFER_INFO};
+  buffer_info.usage = usage;
+  buffer_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  VkExternalBufferProperties props = {VK_STRUCTURE_TYPE_EXTERNAL_BUFFER_PROPERTIES};
+  vkGetPhysicalDeviceExternalBufferProperties(vk->createInfo.gpu, &buffer_info, &props);
+  return (props.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT) != 0;
+}
+
+// Copies the imported staging buffer of a texture into its image. Only the creation waits for the copy, updates are
+// submitted without a CPU wait.
+static void vknvg_copyHostBuffer(VKNVGcontext *vk, VKNVGtexture *tex, bool wait) {
+  VkBufferImageCopy region = {0};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = tex->width;
+  region.imageExtent.height = tex->height;
+  region.imageExtent.depth = 1;
+
+  VkCommandBuffer cmdBuffer = vknvg_beginUpload(vk);
+  // every texel is overwritten, the previous contents can be discarded once earlier draws are done reading them
+  vknvg_imageBarrier(cmdBuffer, tex->image, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+  vkCmdCopyBufferToImage(cmdBuffer, tex->hostBuffer, tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  vknvg_imageBarrier(cmdBuffer, tex->image, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  if (wait) {
+    vknvg_endUpload(vk, cmdBuffer);
+  } else {
+    vknvg_submitUpload(vk, cmdBuffer);
+  }
+}
+
+// Device local buffer filled through a staging copy, or a host visible one when no upload queue was given.
+// Leaves *buf empty on failure.
+static VkResult vknvg_createStaticBuffer(VKNVGcontext *vk, VkBufferUsageFlags usage, const void *data, VkDeviceSize size, VKNVGBuffer *buf) {
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+
+  if (vk->createInfo.queue == VK_NULL_HANDLE) {
+    return vknvg_tryCreateBuffer(device, vk->memoryProperties, allocator, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, data, size, buf);
+  }
+
+  VKNVGBuffer staging;
+  VkResult res = vknvg_tryCreateBuffer(device, vk->memoryProperties, allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, data, size, &staging);
+  if (res != VK_SUCCESS) {
+    VKNVGBuffer empty = {0};
+    *buf = empty;
+    return res;
+  }
+  res = vknvg_tryCreateBuffer(device, vk->memoryProperties, allocator, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, nullptr, size, buf);
+  if (res == VK_SUCCESS) {
+    VkCommandBuffer cmdBuffer = vknvg_beginUpload(vk);
+    VkBufferCopy region = {0, 0, size};
+    vkCmdCopyBuffer(cmdBuffer, staging.buffer, buf->buffer, 1, &region);
+    vknvg_endUpload(vk, cmdBuffer);
+  }
+  vknvg_destroyBuffer(device, allocator, &staging);
+  return res;
+}
+static VkResult vknvg_createStaticArenaBuffer(VKNVGcontext *vk, VkBufferUsageFlags usage, const VKNVGarena *arena, int first, int n, VKNVGBuffer *buf) {
+  VKNVGBuffer empty = {0};
+  *buf = empty;
+  void *data = malloc((size_t)n * arena->elemSize);
+  if (data == nullptr)
+    return VK_ERROR_OUT_OF_HOST_MEMORY;
+  vknvg_arenaCopy(arena, data, first, n);
+  VkResult res = vknvg_createStaticBuffer(vk, usage, data, (VkDeviceSize)n * arena->elemSize, buf);
+  free(data);
+  return res;
+}
+///==================================================================================================================
+// Extension command, or its Vulkan 1.3 core name.
+static PFN_vkVoidFunction vknvg_getDeviceProc(VkDevice device, const char *extName, const char *coreName) {
+  PFN_vkVoidFunction proc = vkGetDeviceProcAddr(device, extName);
+  return proc ? proc : vkGetDeviceProcAddr(device, coreName);
+}
+
+static void vknvg_loadDynamicState(VKNVGcontext *vk) {
+  VkDevice device = vk->createInfo.device;
+  vk->cmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vknvg_getDeviceProc(device, "vkCmdSetPrimitiveTopologyEXT", "vkCmdSetPrimitiveTopology");
+  vk->cmdSetCullMode = (PFN_vkCmdSetCullModeEXT)vknvg_getDeviceProc(device, "vkCmdSetCullModeEXT", "vkCmdSetCullMode");
+  vk->cmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT)vknvg_getDeviceProc(device, "vkCmdSetDepthTestEnableEXT", "vkCmdSetDepthTestEnable");
+  vk->cmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT)vknvg_getDeviceProc(device, "vkCmdSetDepthWriteEnableEXT", "vkCmdSetDepthWriteEnable");
+  vk->cmdSetStencilTestEnable = (PFN_vkCmdSetStencilTestEnableEXT)vknvg_getDeviceProc(device, "vkCmdSetStencilTestEnableEXT", "vkCmdSetStencilTestEnable");
+  vk->cmdSetStencilOp = (PFN_vkCmdSetStencilOpEXT)vknvg_getDeviceProc(device, "vkCmdSetStencilOpEXT", "vkCmdSetStencilOp");
+  vk->dynamicState = vk->cmdSetPrimitiveTopology && vk->cmdSetCullMode && vk->cmdSetDepthTestEnable &&
+                     vk->cmdSetDepthWriteEnable && vk->cmdSetStencilTestEnable && vk->cmdSetStencilOp;
+#ifdef VK_EXT_extended_dynamic_state3
+  vk->cmdSetColorBlendEnable = (PFN_vkCmdSetColorBlendEnableEXT)vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT");
+  vk->cmdSetColorBlendEquation = (PFN_vkCmdSetColorBlendEquationEXT)vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEquationEXT");
+  vk->cmdSetColorWriteMask = (PFN_vkCmdSetColorWriteMaskEXT)vkGetDeviceProcAddr(device, "vkCmdSetColorWriteMaskEXT");
+  vk->dynamicBlend = vk->dynamicState && vk->cmdSetColorBlendEnable && vk->cmdSetColorBlendEquation && vk->cmdSetColorWriteMask;
+#endif
+}
+
+static int vknvg_renderCreateTexture(void *uptr, int type, int w, int h, int imageFlags, const unsigned char *data);
+
+static bool vknvg_hasDeviceExtension(VkPhysicalDevice gpu, const char *name) {
+  uint32_t count = 0;
+  if (vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, nullptr) != VK_SUCCESS || count == 0)
+    return false;
+  VkExtensionProperties *extensions = (VkExtensionProperties *)malloc(sizeof(VkExtensionProperties) * count);
+  if (extensions == nullptr)
+    return false;
+  bool found = false;
+  if (vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, extensions) == VK_SUCCESS) {
+    for (uint32_t i = 0; i < count && !found; i++) {
+      found = strcmp(extensions[i].extensionName, name) == 0;
+    }
+  }
+  free(extensions);
+  return found;
+}
+
+static int vknvg_renderCreate(void *uptr) {
+  VKNVGcontext *vk = (VKNVGcontext *)uptr;
+
+  vkGetPhysicalDeviceMemoryProperties(vk->createInfo.gpu, &vk->memoryProperties);
+  vkGetPhysicalDeviceProperties(vk->createInfo.gpu, &vk->gpuProperties);
+  vk->memoryBudget = vknvg_hasDeviceExtension(vk->createInfo.gpu, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  if (vk->createInfo.deviceCache) {
+    vk->cache = vk->createInfo.deviceCache;
+    vknvg_retainDeviceCache(vk->cache);
+  } else {
+    vk->cache = nvgVkCreateDeviceCache(vk->createInfo.gpu, vk->createInfo.device, vk->createInfo.allocator);
+    if (vk->cache == nullptr)
+      return 0;
+  }
+
+  if (vk->flags & NVG_DYNAMIC_STATE) {
+    vknvg_loadDynamicState(vk);
+  }
 
-  vk->fillVertShader = vknvg_createShaderModule(device, fillVertShader, sizeof(fillVertShader), allocator);
-  vk->fillFragShader = vknvg_createShaderModule(device, fillFragShader, sizeof(fillFragShader), allocator);
-  vk->fillFragShaderAA = vknvg_createShaderModule(device, fillFragShaderAA, sizeof(fillFragShaderAA), allocator);
   int align = vk->gpuProperties.limits.minUniformBufferOffsetAlignment;
 
   vk->fragSize = sizeof(VKNVGfragUniforms) + align - sizeof(VKNVGfragUniforms) % align;
 
-  vk->descLayout = vknvg_createDescriptorSetLayout(device, allocator);
-  vk->pipelineLayout = vknvg_createPipelineLayout(device, vk->descLayout, allocator);
+  vknvg_initArena(&vk->calls, sizeof(VKNVGcall), 128);
+  vknvg_initArena(&vk->paths, sizeof(VKNVGpath), 128);
+  vknvg_initArena(&vk->verts, sizeof(NVGvertex), 4096);
+  vknvg_initArena(&vk->packedVerts, sizeof(VKNVGpackedVertex), 4096);
+  vknvg_initArena(&vk->uniforms, vk->fragSize, 128);
+  vknvg_initArena(&vk->coverage, sizeof(float) * 4, 4096);
+  vknvg_initArena(&vk->glyphs, sizeof(VKNVGglyph), 1024);
+
+  vk->nframes = vknvg_maxi((int)vk->createInfo.framesInFlight, 1);
+  vk->frames = (VKNVGframeResources *)calloc(vk->nframes, sizeof(VKNVGframeResources));
+  if (vk->frames == nullptr)
+    return 0;
+
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    vknvg_initBindless(vk->cache);
+    vk->textureDescPool = vknvg_createTextureDescriptorPool(vk->createInfo.device, vk->createInfo.allocator);
+    VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, vk->textureDescPool, 1, &vk->cache->textureDescLayout};
+    NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(vk->createInfo.device, &alloc_info, &vk->textureDescSet));
+  }
+
+  // bound in place of a missing or deleted image
+  static const unsigned char white[4] = {255, 255, 255, 255};
+  vk->dummyImage = vknvg_renderCreateTexture(vk, NVG_TEXTURE_RGBA, 1, 1, 0, white);
+  if (vk->dummyImage == 0)
+    return 0;
+  vknvg_findTexture(vk, vk->dummyImage)->evictable = false;
   return 1;
 }
 
-static int vknvg_renderCreateTexture(void *uptr, int type, int w, int h, int imageFlags, const unsigned char *data) {
-  VKNVGcontext *vk = (VKNVGcontext *)uptr;
-  VKNVGtexture *tex = vknvg_allocTexture(vk);
-  if (!tex) {
-    return 0;
+// Alpha images sample as (a, a, a, a), the premultiplied white the shaders expect from every image.
+static VkComponentMapping vknvg_textureSwizzle(int type) {
+  VkComponentMapping mapping = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A};
+  if (type == NVG_TEXTURE_ALPHA) {
+    mapping.g = mapping.b = mapping.a = VK_COMPONENT_SWIZZLE_R;
   }
+  return mapping;
+}
 
+// Creates the linear, host visible image of a texture made by vknvg_renderCreateTexture, from its type and size.
+// Leaves tex without an image on failure.
+static VkResult vknvg_createTextureImage(VKNVGcontext *vk, VKNVGtexture *tex) {
   VkDevice device = vk->createInfo.device;
   const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
 
   VkImageCreateInfo image_createInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
   image_createInfo.pNext = nullptr;
   image_createInfo.imageType = VK_IMAGE_TYPE_2D;
-  if (type == NVG_TEXTURE_RGBA) {
+  if (tex->type == NVG_TEXTURE_RGBA) {
     image_createInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
   } else {
     image_createInfo.format = VK_FORMAT_R8_UNORM;
   }
 
-  image_createInfo.extent.width = w;
-  image_createInfo.extent.height = h;
+  image_createInfo.extent.width = tex->width;
+  image_createInfo.extent.height = tex->height;
   image_createInfo.extent.depth = 1;
   image_createInfo.mipLevels = 1;
   image_createInfo.arrayLayers = 1;
@@ -1183,65 +3297,21 @@ static int vknvg_renderCreateTexture(void *uptr, int type, int w, int h, int ima
   image_createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   image_createInfo.flags = 0;
 
-  VkMemoryAllocateInfo mem_alloc = {VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
-  mem_alloc.allocationSize = 0;
-
   VkImage mappableImage;
   VkDeviceMemory mappableMemory;
-
-  NVGVK_CHECK_RESULT(vkCreateImage(device, &image_createInfo, allocator, &mappableImage));
+  VkResult res = vknvg_createImage(vk, &image_createInfo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &mappableImage, &mappableMemory);
+  if (res != VK_SUCCESS)
+    return res;
 
   VkMemoryRequirements mem_reqs;
   vkGetImageMemoryRequirements(device, mappableImage, &mem_reqs);
 
-  mem_alloc.allocationSize = mem_reqs.size;
-
-  VkResult res = vknvg_memory_type_from_properties(vk->memoryProperties, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &mem_alloc.memoryTypeIndex);
-  assert(res == VK_SUCCESS);
-
-  NVGVK_CHECK_RESULT(vkAllocateMemory(device, &mem_alloc, allocator, &mappableMemory));
-
-  NVGVK_CHECK_RESULT(vkBindImageMemory(device, mappableImage, mappableMemory, 0));
-
-  VkSamplerCreateInfo samplerCreateInfo = {VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
-  if (imageFlags & NVG_IMAGE_NEAREST) {
-    samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
-    samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
-  } else {
-    samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
-    samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
-  }
-  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-  if (imageFlags & NVG_IMAGE_REPEATX) {
-    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
-  } else {
-    samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-  }
-  samplerCreateInfo.mipLodBias = 0.0;
-  samplerCreateInfo.anisotropyEnable = VK_FALSE;
-  samplerCreateInfo.maxAnisotropy = 1;
-  samplerCreateInfo.compareEnable = VK_FALSE;
-  samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
-  samplerCreateInfo.minLod = 0.0;
-  samplerCreateInfo.maxLod = 0.0;
-  samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-
-  /* create sampler */
-  NVGVK_CHECK_RESULT(vkCreateSampler(device, &samplerCreateInfo, allocator, &tex->sampler));
-
   VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
   view_info.pNext = nullptr;
   view_info.image = mappableImage;
   view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
   view_info.format = image_createInfo.format;
-  view_info.components.r = VK_COMPONENT_SWIZZLE_R;
-  view_info.components.g = VK_COMPONENT_SWIZZLE_G;
-  view_info.components.b = VK_COMPONENT_SWIZZLE_B;
-  view_info.components.a = VK_COMPONENT_SWIZZLE_A;
+  view_info.components = vknvg_textureSwizzle(tex->type);
   view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   view_info.subresourceRange.baseMipLevel = 0;
   view_info.subresourceRange.levelCount = 1;
@@ -1249,21 +3319,59 @@ static int vknvg_renderCreateTexture(void *uptr, int type, int w, int h, int ima
   view_info.subresourceRange.layerCount = 1;
 
   VkImageView image_view;
-  NVGVK_CHECK_RESULT(vkCreateImageView(device, &view_info, allocator, &image_view));
+  res = vkCreateImageView(device, &view_info, allocator, &image_view);
+  if (res != VK_SUCCESS) {
+    vkDestroyImage(device, mappableImage, allocator);
+    vkFreeMemory(device, mappableMemory, allocator);
+    return res;
+  }
 
-  tex->height = h;
-  tex->width = w;
   tex->image = mappableImage;
   tex->view = image_view;
   tex->mem = mappableMemory;
+  tex->memSize = mem_reqs.size;
+  tex->evicted = false;
+  vk->textureMemory += mem_reqs.size;
+  uint32_t memoryTypeIndex;
+  if (vknvg_memory_type_from_properties(vk->memoryProperties, mem_reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &memoryTypeIndex) == VK_SUCCESS)
+    vk->textureHeap = vk->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    vknvg_writeTextureDescriptor(vk, vknvg_textureIndex(tex), tex);
+  }
+  return VK_SUCCESS;
+}
+
+static int vknvg_renderCreateTexture(void *uptr, int type, int w, int h, int imageFlags, const unsigned char *data) {
+  VKNVGcontext *vk = (VKNVGcontext *)uptr;
+  VKNVGtexture *tex = vknvg_allocTexture(vk);
+  if (!tex) {
+    return 0;
+  }
+
+  tex->sampler = vknvg_getSampler(vk->cache, imageFlags);
+  tex->height = h;
+  tex->width = w;
   tex->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
   tex->type = type;
   tex->flags = imageFlags;
+  tex->sdfRange = VKNVG_DEFAULT_SDF_RANGE;
+  tex->mappable = true;
+  // distance fields hold distances, not colors
+  if (type == NVG_TEXTURE_RGBA && !(imageFlags & (NVG_IMAGE_PREMULTIPLIED | NVG_IMAGE_SDF | NVG_IMAGE_MSDF))) {
+    tex->premultiply = true;
+    tex->flags |= NVG_IMAGE_PREMULTIPLIED;
+  }
+  // the application can restore the images it created, not the font atlas
+  tex->evictable = type == NVG_TEXTURE_RGBA;
+  if (vknvg_createTextureImage(vk, tex) != VK_SUCCESS) {
+    vknvg_deleteTexture(vk, tex);
+    return 0;
+  }
   if (data) {
-    vknvg_UpdateTexture(device, tex, 0, 0, w, h, data);
+    vknvg_UpdateTexture(vk->createInfo.device, tex, 0, 0, w, h, data);
   }
 
-  return vknvg_textureId(vk, tex);
+  return tex->id;
 }
 static int vknvg_renderDeleteTexture(void *uptr, int image) {
 
@@ -1277,8 +3385,26 @@ static int vknvg_renderUpdateTexture(void *uptr, int image, int x, int y, int w,
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
 
   VKNVGtexture *tex = vknvg_findTexture(vk, image);
-  vknvg_UpdateTexture(vk->createInfo.device, tex, x, y, w, h, data);
-  return 1;
+  if (tex == nullptr) {
+    return 0;
+  }
+  if (tex->evicted && !vknvg_useTexture(vk, tex)) {
+    return 0;
+  }
+  if (tex->hostPointer != nullptr) {
+    unsigned char *host = (unsigned char *)tex->hostPointer;
+    if (data != host) {
+      for (int row = y; row < y + h; row++) {
+        size_t offset = ((size_t)row * tex->width + x) * 4;
+        memcpy(host + offset, data + offset, (size_t)w * 4);
+      }
+    }
+    if (tex->hostBuffer != VK_NULL_HANDLE) {
+      vknvg_copyHostBuffer(vk, tex, false);
+    }
+    return 1;
+  }
+  return vknvg_UpdateTexture(vk->createInfo.device, tex, x, y, w, h, data);
 }
 static int vknvg_renderGetTextureSize(void *uptr, int image, int *w, int *h) {
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
@@ -1294,58 +3420,287 @@ static void vknvg_renderViewport(void *uptr, int width, int height, float device
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
   vk->view[0] = (float)width;
   vk->view[1] = (float)height;
+  vk->devicePixelRatio = devicePixelRatio;
+  // offscreen passes set a viewport of their own at 0,0
+  vk->viewScissor.offset.x = vk->boundFramebuffer ? 0 : vk->createInfo.viewOffset.x;
+  vk->viewScissor.offset.y = vk->boundFramebuffer ? 0 : vk->createInfo.viewOffset.y;
+  vk->viewScissor.extent.width = (uint32_t)ceilf(width * devicePixelRatio);
+  vk->viewScissor.extent.height = (uint32_t)ceilf(height * devicePixelRatio);
+}
+static void vknvg_resetFrame(VKNVGcontext *vk) {
+  vknvg_arenaReset(&vk->calls);
+  vknvg_arenaReset(&vk->paths);
+  vknvg_arenaReset(&vk->verts);
+  vknvg_arenaReset(&vk->packedVerts);
+  vknvg_arenaReset(&vk->uniforms);
+  vknvg_arenaReset(&vk->coverage);
+  vknvg_arenaReset(&vk->glyphs);
 }
 static void vknvg_renderCancel(void *uptr) {
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
 
-  vk->nverts = 0;
-  vk->npaths = 0;
-  vk->ncalls = 0;
-  vk->nuniforms = 0;
+  vknvg_resetFrame(vk);
+  vk->capturing = false;
+}
+
+// How far ahead of the oldest pending call the reorder pass looks for calls to batch with it.
+#define VKNVG_REORDER_WINDOW 32
+
+static bool vknvg_boundsOverlap(const float *a, const float *b) {
+  return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+// Whether b can be drawn with the pipelines and descriptors bound for a.
+// With NVG_BINDLESS_TEXTURES the image is just a uniform.
+static bool vknvg_callStateEqual(const VKNVGcontext *vk, const VKNVGcall *a, const VKNVGcall *b) {
+  return a->type == b->type && a->type != VKNVG_DISPLAYLIST &&
+         (a->image == b->image || (vk->flags & NVG_BINDLESS_TEXTURES)) &&
+         a->shaderType == b->shaderType &&
+         a->texType == b->texType &&
+         memcmp(&a->compositOperation, &b->compositOperation, sizeof(NVGcompositeOperationState)) == 0;
+}
+
+// Greedy reorder: emits the oldest pending call, then pulls in the following calls with the same state that do not
+// overlap any pending call they would jump over. Overlapping calls keep their painter's order.
+// Returns the draw order as indices of the frame's calls, null to draw them as submitted.
+static const int *vknvg_reorderCalls(VKNVGcontext *vk) {
+  int n = vk->calls.count;
+  if (n < 3)
+    return nullptr;
+  if (vk->creorder < n) {
+    int creorder = n + n / 2; // 1.5x Overallocate
+    int *order = (int *)realloc(vk->callOrder, sizeof(int) * creorder);
+    if (order == nullptr)
+      return nullptr;
+    vk->callOrder = order;
+    int *links = (int *)realloc(vk->reorderLinks, sizeof(int) * creorder);
+    if (links == nullptr)
+      return nullptr;
+    vk->reorderLinks = links;
+    vk->creorder = creorder;
+  }
+
+  // singly linked list of pending calls, in submission order
+  int *next = vk->reorderLinks;
+  for (int i = 0; i < n; i++) {
+    next[i] = i + 1 < n ? i + 1 : -1;
+  }
+  int head = 0, nsorted = 0;
+  int skipped[VKNVG_REORDER_WINDOW];
+
+  while (head != -1) {
+    const VKNVGcall *last = vknvg_frameCall(vk, head);
+    vk->callOrder[nsorted++] = head;
+    head = next[head];
+
+    int nskipped = 0, prev = -1;
+    for (int c = head; c != -1 && nskipped < VKNVG_REORDER_WINDOW;) {
+      const VKNVGcall *call = vknvg_frameCall(vk, c);
+      bool movable = vknvg_callStateEqual(vk, last, call);
+      for (int k = 0; movable && k < nskipped; k++) {
+        movable = !vknvg_boundsOverlap(call->bounds, vknvg_frameCall(vk, skipped[k])->bounds);
+      }
+      if (movable) {
+        vk->callOrder[nsorted++] = c;
+        if (prev == -1)
+          head = next[c];
+        else
+          next[prev] = next[c];
+      } else {
+        skipped[nskipped++] = c;
+        prev = c;
+      }
+      c = next[c];
+    }
+  }
+  return vk->callOrder;
+}
+
+// Buffers and descriptor pool for the next flush of the current frame, last used nframes frames ago.
+static VKNVGflushResources *vknvg_acquireFlush(VKNVGcontext *vk) {
+  VKNVGframeResources *frame = &vk->frames[vk->frameIndex % vk->nframes];
+  if (frame->nflushes + 1 > frame->cflushes) {
+    VKNVGflushResources *flushes;
+    int cflushes = vknvg_maxi(frame->nflushes + 1, 2) + frame->cflushes / 2; // 1.5x Overallocate
+    flushes = (VKNVGflushResources *)realloc(frame->flushes, sizeof(VKNVGflushResources) * cflushes);
+    if (flushes == nullptr)
+      return nullptr;
+    memset(flushes + frame->cflushes, 0, sizeof(VKNVGflushResources) * (cflushes - frame->cflushes));
+    frame->flushes = flushes;
+    frame->cflushes = cflushes;
+  }
+  VKNVGflushResources *flush = &frame->flushes[frame->nflushes];
+  if (flush->coverageBuffer.buffer == VK_NULL_HANDLE) {
+    // bound in every descriptor set, so it has to exist before the first coverage fill
+    float emptyRecord[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    flush->coverageBuffer = vknvg_createBuffer(vk->createInfo.device, vk->memoryProperties, vk->createInfo.allocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, emptyRecord, sizeof(emptyRecord));
+  }
+  frame->nflushes++;
+  return flush;
+}
+
+static void vknvg_destroyFlushResources(VKNVGcontext *vk, VKNVGflushResources *flush) {
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+  vknvg_destroyBuffer(device, allocator, &flush->vertexBuffer);
+  vknvg_destroyBuffer(device, allocator, &flush->fragUniformBuffer);
+  vknvg_destroyBuffer(device, allocator, &flush->vertUniformBuffer);
+  vknvg_destroyBuffer(device, allocator, &flush->coverageBuffer);
+  vknvg_destroyBuffer(device, allocator, &flush->glyphBuffer);
+  vkDestroyDescriptorPool(device, flush->descPool, allocator);
+}
+
+// Retires what the frame released once framesInFlight frames have passed, and moves on to the next frame of the ring,
+// whose buffers the GPU is done with.
+static void vknvg_endFrame(VKNVGcontext *vk) {
+  vknvg_enforceTextureBudget(vk);
+
+  // before counting this frame, which may use what was released during it
+  vknvg_collectGarbage(vk, false);
+  vknvg_retireUploads(vk, false);
+  vk->frameIndex++;
+  vk->frames[vk->frameIndex % vk->nframes].nflushes = 0;
 }
 
 static void vknvg_renderFlush(void *uptr) {
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
   VkDevice device = vk->createInfo.device;
   VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
-  VkRenderPass renderpass = vk->createInfo.renderpass;
-  VkPhysicalDeviceMemoryProperties memoryProperties = vk->memoryProperties;
   const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
 
-  int i;
-  if (vk->ncalls > 0) {
-    vknvg_UpdateBuffer(device, allocator, &vk->vertexBuffer, memoryProperties, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vk->verts, vk->nverts * sizeof(vk->verts[0]));
-    vknvg_UpdateBuffer(device, allocator, &vk->fragUniformBuffer, memoryProperties, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vk->uniforms, vk->nuniforms * vk->fragSize);
-    vknvg_UpdateBuffer(device, allocator, &vk->vertUniformBuffer, memoryProperties, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vk->view, sizeof(vk->view));
+  vknvg_restoreTextures(vk);
+
+  int i, ncalls = vk->calls.count;
+  VKNVGflushResources *flush = ncalls > 0 ? vknvg_acquireFlush(vk) : nullptr;
+  if (flush != nullptr) {
+    vk->flush = flush;
+    const int *order = (vk->flags & NVG_REORDER_CALLS) ? vknvg_reorderCalls(vk) : nullptr;
+    const VKNVGarena *verts = (vk->flags & NVG_PACKED_VERTICES) ? &vk->packedVerts : &vk->verts;
+    vknvg_UpdateArenaBuffer(vk, &flush->vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, verts);
+    vknvg_UpdateArenaBuffer(vk, &flush->fragUniformBuffer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vk->uniforms);
+    vknvg_UpdateBuffer(vk, &flush->vertUniformBuffer, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, vk->view, sizeof(vk->view));
+    vknvg_UpdateArenaBuffer(vk, &flush->coverageBuffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vk->coverage);
+    vknvg_UpdateArenaBuffer(vk, &flush->glyphBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vk->glyphs);
     vk->currentPipeline = nullptr;
-
-    if (vk->ncalls > vk->cdescPool) {
-      vkDestroyDescriptorPool(device, vk->descPool, allocator);
-      vk->descPool = vknvg_createDescriptorPool(device, vk->ncalls, allocator);
-      vk->cdescPool = vk->ncalls;
+    vk->dynamicStateSet = false;
+    vk->currentScissor = vk->viewScissor;
+    vk->drawPaths = nullptr;
+    vk->drawVertexBuffer = flush->vertexBuffer.buffer;
+    vk->drawFragUniformBuffer = flush->fragUniformBuffer.buffer;
+    vk->drawGlyphBuffer = flush->glyphBuffer.buffer;
+
+    // replayed display lists allocate descriptor sets for each of their calls, opaque calls one more for their fringes
+    int ndraws = 0;
+    for (i = 0; i < ncalls; i++) {
+      const VKNVGcall *call = vknvg_frameCall(vk, i);
+      ndraws += call->type == VKNVG_DISPLAYLIST ? call->displayList->ncalls : 1;
+      ndraws += call->opaque ? 1 : 0;
+    }
+    ndraws += 2; // stencilDescSet, drawDescSet
+    if (ndraws > flush->cdescPool) {
+      VKNVGgarbage g = {0};
+      g.descPool = flush->descPool;
+      vknvg_release(vk, g);
+      flush->descPool = vknvg_createDescriptorPool(device, ndraws, allocator);
+      flush->cdescPool = ndraws;
     } else {
-      vkResetDescriptorPool(device, vk->descPool, 0);
+      vkResetDescriptorPool(device, flush->descPool, 0);
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, flush->descPool, 1, &vk->cache->stencilDescLayout};
+    NVGVK_CHECK_RESULT(vkAllocateDescriptorSets(device, &alloc_info, &vk->stencilDescSet));
+    VkDescriptorBufferInfo vertUniformBufferInfo = {flush->vertUniformBuffer.buffer, 0, sizeof(vk->view)};
+    VkWriteDescriptorSet write = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = vk->stencilDescSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    write.pBufferInfo = &vertUniformBufferInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    if (vk->flags & NVG_BINDLESS_TEXTURES) {
+      vk->drawDescSet = vknvg_allocBindlessSet(vk, flush->fragUniformBuffer.buffer);
     }
 
-    for (i = 0; i < vk->ncalls; i++) {
-      VKNVGcall *call = &vk->calls[i];
-      if (call->type == VKNVG_FILL)
-        vknvg_fill(vk, call);
-      else if (call->type == VKNVG_CONVEXFILL)
-        vknvg_convexFill(vk, call);
-      else if (call->type == VKNVG_STROKE)
-        vknvg_stroke(vk, call);
-      else if (call->type == VKNVG_TRIANGLES) {
-        vknvg_triangles(vk, call);
+    static const float identity[6] = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+    static const float noDequant[4] = {1.0f, 1.0f, 0.0f, 0.0f};
+    vknvg_pushConstants(vk, cmdBuffer, identity, 1.0f);
+    vknvg_pushDepth(vk, cmdBuffer, 0.0f);
+    vknvg_pushDequant(vk, cmdBuffer, noDequant, noDequant);
+
+    if (vk->flags & NVG_DEPTH_OVERDRAW) {
+      // Opaque pass, front to back. Opaque calls are never scissored.
+      for (i = ncalls - 1; i >= 0; i--) {
+        VKNVGcall *call = vknvg_frameCall(vk, order ? order[i] : i);
+        if (!call->opaque)
+          continue;
+        vknvg_pushDepth(vk, cmdBuffer, vknvg_callDepth(i, ncalls));
+        if (vk->flags & NVG_PACKED_VERTICES) {
+          vknvg_pushDequant(vk, cmdBuffer, call->posDequant, call->uvDequant);
+        }
+        vknvg_opaqueFill(vk, call);
       }
     }
+    for (i = 0; i < ncalls; i++) {
+      if (vk->flags & NVG_DEPTH_OVERDRAW) {
+        vknvg_pushDepth(vk, cmdBuffer, vknvg_callDepth(i, ncalls));
+      }
+      vknvg_drawCall(vk, vknvg_frameCall(vk, order ? order[i] : i));
+    }
+    // a no-op unless a scissored call replaced the caller's scissor
+    vknvg_setScissor(vk, cmdBuffer, &vk->viewScissor);
   }
   // Reset calls
-  vk->nverts = 0;
-  vk->npaths = 0;
-  vk->ncalls = 0;
-  vk->nuniforms = 0;
+  vknvg_resetFrame(vk);
+  vk->capturing = false;
+  vk->flush = nullptr;
+  // offscreen passes are recorded into the frame's command buffer, ahead of its main pass
+  if (!vk->explicitFrames && vk->boundFramebuffer == nullptr) {
+    vknvg_endFrame(vk);
+  }
 }
+// Whether an opaque source simply replaces what is below.
+static bool vknvg_isSourceOver(NVGcompositeOperationState op) {
+  return op.srcRGB == NVG_ONE && op.srcAlpha == NVG_ONE && op.dstRGB == NVG_ONE_MINUS_SRC_ALPHA && op.dstAlpha == NVG_ONE_MINUS_SRC_ALPHA;
+}
+
+// Most subpaths vknvg_disjointConvex compares, quadratic in the count.
+#define VKNVG_MAX_DISJOINT_PATHS 128
+
+// Whether every subpath is convex and no two overlap, fringes included: a row of dots, the parts of an icon.
+// Their nonzero fill is then each subpath filled on its own, which the convex fill draws without the stencil.
+static bool vknvg_disjointConvex(const NVGpath *paths, int npaths) {
+  float bounds[VKNVG_MAX_DISJOINT_PATHS][4];
+  if (npaths > VKNVG_MAX_DISJOINT_PATHS)
+    return false;
+  for (int i = 0; i < npaths; i++) {
+    if (!paths[i].convex)
+      return false;
+    vknvg_boundsInit(bounds[i]);
+    if (paths[i].nstroke > 0)
+      vknvg_boundsAdd(bounds[i], paths[i].stroke, paths[i].nstroke);
+    else
+      vknvg_boundsAdd(bounds[i], paths[i].fill, paths[i].nfill);
+    for (int j = 0; j < i; j++) {
+      if (vknvg_boundsOverlap(bounds[i], bounds[j]))
+        return false;
+    }
+  }
+  return true;
+}
+
+// nanovg only halves the fringe of single convex paths. The full fringe of the others also fades into the
+// interior, where the stencil keeps it from drawing twice. Moving each inner vertex (the even one, u = 0) to the
+// middle of its pair gives the half fringe, from the inset fill edge with u = 0.5 to the unchanged outer vertex.
+// At bevel and inner bevel joins the pair is not placed as a straight join's, so there the midpoint only
+// approximates the half fringe nanovg would have generated.
+static void vknvg_halveFringe(NVGvertex *verts, int nverts) {
+  for (int i = 0; i + 1 < nverts; i += 2) {
+    verts[i].x = 0.5f * (verts[i].x + verts[i + 1].x);
+    verts[i].y = 0.5f * (verts[i].y + verts[i + 1].y);
+    verts[i].u = 0.5f * (verts[i].u + verts[i + 1].u);
+  }
+}
+
 static void vknvg_renderFill(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor, float fringe,
                              const float *bounds, const NVGpath *paths, int npaths) {
 
@@ -1353,95 +3708,127 @@ static void vknvg_renderFill(void *uptr, NVGpaint *paint, NVGcompositeOperationS
   VKNVGcall *call = vknvg_allocCall(vk);
   NVGvertex *quad;
   VKNVGfragUniforms *frag;
-  int i, maxverts, offset;
+  float coverage[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  int i, maxverts, offset, vertOffset;
+  bool halveFringes = false;
 
   if (call == NULL)
     return;
 
+  // Fringes reach out of the fill bounds by up to the fringe width.
+  call->bounds[0] = bounds[0] - fringe;
+  call->bounds[1] = bounds[1] - fringe;
+  call->bounds[2] = bounds[2] + fringe;
+  call->bounds[3] = bounds[3] + fringe;
+  call->scissored = vknvg_scissorRect(vk, scissor, fringe, &call->scissorRect);
+  if (!vknvg_boundsVisible(vk, call->bounds, call->scissored, &call->scissorRect))
+    goto error;
+
   call->type = VKNVG_FILL;
   call->triangleCount = 4;
-  call->pathOffset = vknvg_allocPaths(vk, npaths);
-  if (call->pathOffset == -1)
-    goto error;
-  call->pathCount = npaths;
   call->image = paint->image;
   call->compositOperation = compositeOperation;
 
   if (npaths == 1 && paths[0].convex) {
     call->type = VKNVG_CONVEXFILL;
     call->triangleCount = 0; // Bounding box fill quad not needed for convex fill
+  } else if (vknvg_disjointConvex(paths, npaths)) {
+    call->type = VKNVG_CONVEXFILL;
+    call->triangleCount = 0;
+    halveFringes = true;
+  } else if ((vk->flags & NVG_COVERAGE_FILLS) && !vk->capturing && vknvg_coverageEdges(vk, paths, npaths, coverage)) {
+    // Display lists are replayed under other transforms, their fills keep the stencil.
+    call->type = VKNVG_COVERAGEFILL;
+    npaths = 0; // only the quad is drawn
   }
 
+  call->pathOffset = vknvg_allocPaths(vk, npaths);
+  if (call->pathOffset == -1)
+    goto error;
+  call->pathCount = npaths;
+
   // Allocate vertices for all the paths.
   maxverts = vknvg_maxVertCount(paths, npaths) + call->triangleCount;
   offset = vknvg_allocVerts(vk, maxverts);
   if (offset == -1)
     goto error;
+  vertOffset = offset;
 
   for (i = 0; i < npaths; i++) {
-    VKNVGpath *copy = &vk->paths[call->pathOffset + i];
+    VKNVGpath *copy = (VKNVGpath *)vknvg_arenaPtr(&vk->paths, call->pathOffset) + i;
     const NVGpath *path = &paths[i];
     memset(copy, 0, sizeof(VKNVGpath));
     if (path->nfill > 0) {
       copy->fillOffset = offset;
       copy->fillCount = path->nfill;
-      memcpy(&vk->verts[offset], path->fill, sizeof(NVGvertex) * path->nfill);
+      memcpy(vknvg_vertPtr(vk, vertOffset) + (offset - vertOffset), path->fill, sizeof(NVGvertex) * path->nfill);
       offset += path->nfill;
     }
     if (path->nstroke > 0) {
       copy->strokeOffset = offset;
       copy->strokeCount = path->nstroke;
-      memcpy(&vk->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+      memcpy(vknvg_vertPtr(vk, vertOffset) + (offset - vertOffset), path->stroke, sizeof(NVGvertex) * path->nstroke);
+      if (halveFringes) {
+        vknvg_halveFringe(vknvg_vertPtr(vk, vertOffset) + (offset - vertOffset), path->nstroke);
+      }
       offset += path->nstroke;
     }
   }
 
-  // Setup uniforms for draw calls
-  if (call->type == VKNVG_FILL) {
-    // Quad
+  if (call->type == VKNVG_FILL || call->type == VKNVG_COVERAGEFILL) {
+    // Quad, covering the antialiased edge pixels as well for coverage fills
+    const float *quadBounds = call->type == VKNVG_COVERAGEFILL ? call->bounds : bounds;
     call->triangleOffset = offset;
-    quad = &vk->verts[call->triangleOffset];
-    vknvg_vset(&quad[0], bounds[2], bounds[3], 0.5f, 1.0f);
-    vknvg_vset(&quad[1], bounds[2], bounds[1], 0.5f, 1.0f);
-    vknvg_vset(&quad[2], bounds[0], bounds[3], 0.5f, 1.0f);
-    vknvg_vset(&quad[3], bounds[0], bounds[1], 0.5f, 1.0f);
-
-    call->uniformOffset = vknvg_allocFragUniforms(vk, 2);
-    if (call->uniformOffset == -1)
-      goto error;
-    // Simple shader for stencil
-    frag = vknvg_fragUniformPtr(vk, call->uniformOffset);
-    memset(frag, 0, sizeof(*frag));
-    frag->strokeThr = -1.0f;
-    frag->type = NSVG_SHADER_SIMPLE;
-    // Fill shader
-    vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset + vk->fragSize), paint, scissor, fringe, fringe, -1.0f);
-  } else {
-    call->uniformOffset = vknvg_allocFragUniforms(vk, 1);
-    if (call->uniformOffset == -1)
-      goto error;
-    // Fill shader
-    vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset), paint, scissor, fringe, fringe, -1.0f);
+    quad = vknvg_vertPtr(vk, vertOffset) + (call->triangleOffset - vertOffset);
+    vknvg_vset(&quad[0], quadBounds[2], quadBounds[3], 0.5f, 1.0f);
+    vknvg_vset(&quad[1], quadBounds[2], quadBounds[1], 0.5f, 1.0f);
+    vknvg_vset(&quad[2], quadBounds[0], quadBounds[3], 0.5f, 1.0f);
+    vknvg_vset(&quad[3], quadBounds[0], quadBounds[1], 0.5f, 1.0f);
+  }
+  if (vk->flags & NVG_PACKED_VERTICES) {
+    vknvg_packVertices(vk, call, vertOffset, maxverts);
   }
 
+  // Fill shader, the stencil pass uses stencil.frag and needs no uniforms
+  call->uniformOffset = vknvg_allocFragUniforms(vk, 1);
+  if (call->uniformOffset == -1)
+    goto error;
+  frag = vknvg_fragUniformPtr(vk, call->uniformOffset);
+  if (!vknvg_convertPaint(vk, frag, paint, scissor, fringe, fringe, -1.0f))
+    goto error;
+  memcpy(frag->coverage, coverage, sizeof(coverage));
+  call->shaderType = frag->type;
+  call->texType = frag->texType;
+  call->opaque = (vk->flags & NVG_DEPTH_OVERDRAW) && !vk->capturing && call->type == VKNVG_CONVEXFILL && !call->scissored &&
+                 frag->type == NSVG_SHADER_FILLGRAD && paint->innerColor.a >= 1.0f && paint->outerColor.a >= 1.0f &&
+                 vknvg_isSourceOver(compositeOperation);
+
   return;
 
 error:
   // We get here if call alloc was ok, but something else is not.
   // Roll back the last call to prevent drawing it.
-  if (vk->ncalls > 0)
-    vk->ncalls--;
+  if (vk->calls.count > 0)
+    vknvg_arenaRewind(&vk->calls, vk->calls.count - 1);
 }
 
 static void vknvg_renderStroke(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor, float fringe,
                                float strokeWidth, const NVGpath *paths, int npaths) {
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
   VKNVGcall *call = vknvg_allocCall(vk);
-  int i, maxverts, offset;
+  int i, maxverts, offset, vertOffset;
 
   if (call == NULL)
     return;
 
+  vknvg_boundsInit(call->bounds);
+  for (i = 0; i < npaths; i++) {
+    vknvg_boundsAdd(call->bounds, paths[i].stroke, paths[i].nstroke);
+  }
+  call->scissored = vknvg_scissorRect(vk, scissor, fringe, &call->scissorRect);
+  if (!vknvg_boundsVisible(vk, call->bounds, call->scissored, &call->scissorRect))
+    goto error;
+
   call->type = VKNVG_STROKE;
   call->pathOffset = vknvg_allocPaths(vk, npaths);
   if (call->pathOffset == -1)
@@ -1455,18 +3842,22 @@ static void vknvg_renderStroke(void *uptr, NVGpaint *paint, NVGcompositeOperatio
   offset = vknvg_allocVerts(vk, maxverts);
   if (offset == -1)
     goto error;
+  vertOffset = offset;
 
   for (i = 0; i < npaths; i++) {
-    VKNVGpath *copy = &vk->paths[call->pathOffset + i];
+    VKNVGpath *copy = (VKNVGpath *)vknvg_arenaPtr(&vk->paths, call->pathOffset) + i;
     const NVGpath *path = &paths[i];
     memset(copy, 0, sizeof(VKNVGpath));
     if (path->nstroke) {
       copy->strokeOffset = offset;
       copy->strokeCount = path->nstroke;
-      memcpy(&vk->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+      memcpy(vknvg_vertPtr(vk, vertOffset) + (offset - vertOffset), path->stroke, sizeof(NVGvertex) * path->nstroke);
       offset += path->nstroke;
     }
   }
+  if (vk->flags & NVG_PACKED_VERTICES) {
+    vknvg_packVertices(vk, call, vertOffset, offset - vertOffset);
+  }
 
   if (vk->flags & NVG_STENCIL_STROKES) {
     // Fill shader
@@ -1474,36 +3865,169 @@ static void vknvg_renderStroke(void *uptr, NVGpaint *paint, NVGcompositeOperatio
     if (call->uniformOffset == -1)
       goto error;
 
-    vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset), paint, scissor, strokeWidth, fringe, -1.0f);
-    vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset + vk->fragSize), paint, scissor, strokeWidth, fringe, 1.0f - 0.5f / 255.0f);
+    if (!vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset), paint, scissor, strokeWidth, fringe, -1.0f))
+      goto error;
+    vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset + vk->fragSize), paint, scissor, strokeWidth, fringe, 1.0f - 0.5f / 255.0f);
+
+  } else {
+    // Fill shader
+    call->uniformOffset = vknvg_allocFragUniforms(vk, 1);
+    if (call->uniformOffset == -1)
+      goto error;
+    if (!vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset), paint, scissor, strokeWidth, fringe, -1.0f))
+      goto error;
+  }
+  call->shaderType = vknvg_fragUniformPtr(vk, call->uniformOffset)->type;
+  call->texType = vknvg_fragUniformPtr(vk, call->uniformOffset)->texType;
+
+  return;
+
+error:
+  // We get here if call alloc was ok, but something else is not.
+  // Roll back the last call to prevent drawing it.
+  if (vk->calls.count > 0)
+    vknvg_arenaRewind(&vk->calls, vk->calls.count - 1);
+}
+
+// Whether verts are only the glyph quads of nvgText, axis-aligned: each glyph is the triangles
+// (x0,y0) (x1,y1) (x1,y0) and (x0,y0) (x0,y1) (x1,y1), with the matching atlas coordinates.
+static bool vknvg_isGlyphQuads(const NVGvertex *verts, int nverts) {
+  if (nverts == 0 || nverts % 6 != 0)
+    return false;
+  for (int i = 0; i < nverts; i += 6) {
+    const NVGvertex *v = &verts[i];
+    if (memcmp(&v[3], &v[0], sizeof(NVGvertex)) != 0 || memcmp(&v[5], &v[1], sizeof(NVGvertex)) != 0)
+      return false;
+    if (v[2].x != v[1].x || v[2].y != v[0].y || v[2].u != v[1].u || v[2].v != v[0].v)
+      return false;
+    if (v[4].x != v[0].x || v[4].y != v[1].y || v[4].u != v[0].u || v[4].v != v[1].v)
+      return false;
+  }
+  return true;
+}
+
+// What fill.frag reads for a VKNVG_TEXT call, the rest of the uniforms may differ between merged calls.
+static bool vknvg_textUniformsEqual(const VKNVGfragUniforms *a, const VKNVGfragUniforms *b) {
+  return memcmp(a->scissorMat, b->scissorMat, sizeof(a->scissorMat)) == 0 &&
+         memcmp(a->scissorExt, b->scissorExt, sizeof(a->scissorExt)) == 0 &&
+         memcmp(a->scissorScale, b->scissorScale, sizeof(a->scissorScale)) == 0 &&
+         a->texType == b->texType && a->texIndex == b->texIndex && a->sdfRange == b->sdfRange;
+}
+
+static unsigned char vknvg_unorm8(float f) {
+  return (unsigned char)(f <= 0.0f ? 0 : (f >= 1.0f ? 255 : (int)(f * 255.0f + 0.5f)));
+}
+
+// NVG_INSTANCED_TEXT: records the glyphs, appended to the previous call when it is text drawn with the same state.
+// Returns false when verts are not glyph quads, to draw them as triangles.
+static bool vknvg_renderGlyphs(VKNVGcontext *vk, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor,
+                               const NVGvertex *verts, int nverts) {
+  if (!vknvg_isGlyphQuads(verts, nverts))
+    return false;
+
+  float bounds[4];
+  VkRect2D scissorRect;
+  vknvg_boundsInit(bounds);
+  vknvg_boundsAdd(bounds, verts, nverts);
+  bool scissored = vknvg_scissorRect(vk, scissor, 1.0f, &scissorRect);
+  if (!vknvg_boundsVisible(vk, bounds, scissored, &scissorRect))
+    return true;
+
+  VKNVGfragUniforms frag;
+  if (!vknvg_convertPaint(vk, &frag, paint, scissor, 1.0f, 1.0f, -1.0f))
+    return true;
+  frag.type = NSVG_SHADER_IMG;
+  unsigned char color[4] = {vknvg_unorm8(frag.innerCol.r), vknvg_unorm8(frag.innerCol.g), vknvg_unorm8(frag.innerCol.b), vknvg_unorm8(frag.innerCol.a)};
+  frag.innerCol = nvgRGBAf(1.0f, 1.0f, 1.0f, 1.0f);
+
+  // Only the last call can be extended, and not across the start of a display list capture.
+  VKNVGcall *call = nullptr;
+  int last = vk->calls.count - 1;
+  if (last >= 0 && (!vk->capturing || last >= vk->captureCall)) {
+    VKNVGcall *prev = vknvg_frameCall(vk, last);
+    if (prev->type == VKNVG_TEXT && prev->image == paint->image &&
+        prev->glyphOffset + prev->glyphCount == vk->glyphs.count &&
+        prev->scissored == scissored && (!scissored || memcmp(&prev->scissorRect, &scissorRect, sizeof(VkRect2D)) == 0) &&
+        memcmp(&prev->compositOperation, &compositeOperation, sizeof(NVGcompositeOperationState)) == 0 &&
+        vknvg_textUniformsEqual(vknvg_fragUniformPtr(vk, prev->uniformOffset), &frag)) {
+      call = prev;
+    }
+  }
 
-  } else {
-    // Fill shader
+  int nglyphs = nverts / 6;
+  int glyphOffset = vknvg_arenaAlloc(&vk->glyphs, nglyphs);
+  if (glyphOffset == -1)
+    return true;
+
+  if (call == nullptr) {
+    call = vknvg_allocCall(vk);
+    if (call == nullptr)
+      goto error;
     call->uniformOffset = vknvg_allocFragUniforms(vk, 1);
-    if (call->uniformOffset == -1)
+    if (call->uniformOffset == -1) {
+      vknvg_arenaRewind(&vk->calls, vk->calls.count - 1);
       goto error;
-    vknvg_convertPaint(vk, vknvg_fragUniformPtr(vk, call->uniformOffset), paint, scissor, strokeWidth, fringe, -1.0f);
+    }
+    *vknvg_fragUniformPtr(vk, call->uniformOffset) = frag;
+    call->type = VKNVG_TEXT;
+    call->image = paint->image;
+    call->compositOperation = compositeOperation;
+    call->scissored = scissored;
+    call->scissorRect = scissorRect;
+    call->shaderType = frag.type;
+    call->texType = frag.texType;
+    call->glyphOffset = glyphOffset;
+    memcpy(call->bounds, bounds, sizeof(bounds));
+  } else {
+    call->bounds[0] = bounds[0] < call->bounds[0] ? bounds[0] : call->bounds[0];
+    call->bounds[1] = bounds[1] < call->bounds[1] ? bounds[1] : call->bounds[1];
+    call->bounds[2] = bounds[2] > call->bounds[2] ? bounds[2] : call->bounds[2];
+    call->bounds[3] = bounds[3] > call->bounds[3] ? bounds[3] : call->bounds[3];
   }
-
-  return;
+  call->glyphCount += nglyphs;
+
+  {
+    VKNVGglyph *glyphs = (VKNVGglyph *)vknvg_arenaPtr(&vk->glyphs, glyphOffset);
+    for (int i = 0; i < nglyphs; i++) {
+      const NVGvertex *v = &verts[i * 6];
+      VKNVGglyph *g = &glyphs[i];
+      g->rect[0] = v[0].x;
+      g->rect[1] = v[0].y;
+      g->rect[2] = v[1].x;
+      g->rect[3] = v[1].y;
+      g->uv[0] = v[0].u;
+      g->uv[1] = v[0].v;
+      g->uv[2] = v[1].u;
+      g->uv[3] = v[1].v;
+      memcpy(g->color, color, sizeof(color));
+    }
+  }
+  return true;
 
 error:
-  // We get here if call alloc was ok, but something else is not.
-  // Roll back the last call to prevent drawing it.
-  if (vk->ncalls > 0)
-    vk->ncalls--;
+  vknvg_arenaRewind(&vk->glyphs, glyphOffset);
+  return true;
 }
 
 static void vknvg_renderTriangles(void *uptr, NVGpaint *paint, NVGcompositeOperationState compositeOperation, NVGscissor *scissor,
                                   const NVGvertex *verts, int nverts) {
   VKNVGcontext *vk = (VKNVGcontext *)uptr;
 
+  if ((vk->flags & NVG_INSTANCED_TEXT) && vknvg_renderGlyphs(vk, paint, compositeOperation, scissor, verts, nverts))
+    return;
+
   VKNVGcall *call = vknvg_allocCall(vk);
   VKNVGfragUniforms *frag;
 
   if (call == nullptr)
     return;
 
+  vknvg_boundsInit(call->bounds);
+  vknvg_boundsAdd(call->bounds, verts, nverts);
+  call->scissored = vknvg_scissorRect(vk, scissor, 1.0f, &call->scissorRect);
+  if (!vknvg_boundsVisible(vk, call->bounds, call->scissored, &call->scissorRect))
+    goto error;
+
   call->type = VKNVG_TRIANGLES;
   call->image = paint->image;
   call->compositOperation = compositeOperation;
@@ -1514,23 +4038,29 @@ static void vknvg_renderTriangles(void *uptr, NVGpaint *paint, NVGcompositeOpera
     goto error;
   call->triangleCount = nverts;
 
-  memcpy(&vk->verts[call->triangleOffset], verts, sizeof(NVGvertex) * nverts);
+  memcpy(vknvg_vertPtr(vk, call->triangleOffset), verts, sizeof(NVGvertex) * nverts);
+  if (vk->flags & NVG_PACKED_VERTICES) {
+    vknvg_packVertices(vk, call, call->triangleOffset, nverts);
+  }
 
   // Fill shader
   call->uniformOffset = vknvg_allocFragUniforms(vk, 1);
   if (call->uniformOffset == -1)
     goto error;
   frag = vknvg_fragUniformPtr(vk, call->uniformOffset);
-  vknvg_convertPaint(vk, frag, paint, scissor, 1.0f, 1.0f, -1.0f);
+  if (!vknvg_convertPaint(vk, frag, paint, scissor, 1.0f, 1.0f, -1.0f))
+    goto error;
   frag->type = NSVG_SHADER_IMG;
+  call->shaderType = frag->type;
+  call->texType = frag->texType;
 
   return;
 
 error:
   // We get here if call alloc was ok, but something else is not.
   // Roll back the last call to prevent drawing it.
-  if (vk->ncalls > 0)
-    vk->ncalls--;
+  if (vk->calls.count > 0)
+    vknvg_arenaRewind(&vk->calls, vk->calls.count - 1);
 }
 
 static void vknvg_renderDelete(void *uptr) {
@@ -1541,28 +4071,44 @@ static void vknvg_renderDelete(void *uptr) {
   const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
 
   for (int i = 0; i < vk->ntextures; i++) {
-    if (vk->textures[i].image != VK_NULL_HANDLE) {
-      vknvg_deleteTexture(vk, &vk->textures[i]);
-    }
+    vknvg_deleteTexture(vk, vknvg_textureSlot(vk, i));
   }
 
-  vknvg_destroyBuffer(device, allocator, &vk->vertexBuffer);
-  vknvg_destroyBuffer(device, allocator, &vk->fragUniformBuffer);
-  vknvg_destroyBuffer(device, allocator, &vk->vertUniformBuffer);
-
-  vkDestroyShaderModule(device, vk->fillVertShader, allocator);
-  vkDestroyShaderModule(device, vk->fillFragShader, allocator);
-  vkDestroyShaderModule(device, vk->fillFragShaderAA, allocator);
-
-  vkDestroyDescriptorPool(device, vk->descPool, allocator);
-  vkDestroyDescriptorSetLayout(device, vk->descLayout, allocator);
-  vkDestroyPipelineLayout(device, vk->pipelineLayout, allocator);
+  for (int i = 0; vk->frames != nullptr && i < vk->nframes; i++) {
+    for (int j = 0; j < vk->frames[i].cflushes; j++) {
+      vknvg_destroyFlushResources(vk, &vk->frames[i].flushes[j]);
+    }
+    free(vk->frames[i].flushes);
+  }
+  free(vk->frames);
+
+  // pending copies may still read host buffers of the garbage
+  vknvg_retireUploads(vk, true);
+  free(vk->uploads);
+  vknvg_collectGarbage(vk, true);
+  vkDestroyDescriptorPool(device, vk->textureDescPool, allocator);
+  if (vk->uploadCmdPool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, vk->uploadCmdPool, allocator);
+  }
 
-  for (int i = 0; i < vk->npipelines; i++) {
-    vkDestroyPipeline(device, vk->pipelines[i].pipeline, allocator);
+  if (vk->cache) {
+    vknvg_releaseDeviceCache(vk->cache);
   }
 
-  free(vk->textures);
+  free(vk->garbage);
+  for (int i = 0; i < vk->ntextureChunks; i++) {
+    free(vk->textureChunks[i]);
+  }
+  free(vk->textureChunks);
+  vknvg_destroyArena(&vk->paths);
+  vknvg_destroyArena(&vk->verts);
+  vknvg_destroyArena(&vk->packedVerts);
+  vknvg_destroyArena(&vk->uniforms);
+  vknvg_destroyArena(&vk->coverage);
+  vknvg_destroyArena(&vk->glyphs);
+  vknvg_destroyArena(&vk->calls);
+  free(vk->callOrder);
+  free(vk->reorderLinks);
   free(vk);
 }
 
@@ -1588,10 +4134,20 @@ NVGcontext *nvgCreateVk(VKNVGCreateInfo createInfo, int flags) {
   params.renderTriangles = vknvg_renderTriangles;
   params.renderDelete = vknvg_renderDelete;
   params.userPtr = vk;
+  if (createInfo.sampleCount == 0) {
+    createInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+  }
+  vk->antialias = (flags & NVG_ANTIALIAS) != 0;
+  if (createInfo.sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+    // multisampling antialiases the edges, fringes would only add vertices and draws; see nvgVkBindFramebuffer
+    flags &= ~NVG_ANTIALIAS;
+  }
   params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
 
   vk->flags = flags;
   vk->createInfo = createInfo;
+  vk->renderpass = createInfo.renderpass;
+  vk->vertexSize = (flags & NVG_PACKED_VERTICES) ? sizeof(VKNVGpackedVertex) : sizeof(NVGvertex);
 
   ctx = nvgCreateInternal(&params);
   if (ctx == nullptr)
@@ -1609,6 +4165,672 @@ void nvgDeleteVk(NVGcontext *ctx) {
   nvgDeleteInternal(ctx);
 }
 
+void nvgVkEndFrame(NVGcontext *ctx) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  vk->explicitFrames = true;
+  vknvg_endFrame(vk);
+}
+
+VKNVGdeviceCache *nvgVkCreateDeviceCache(VkPhysicalDevice gpu, VkDevice device, const VkAllocationCallbacks *allocator) {
+  VKNVGdeviceCache *cache = (VKNVGdeviceCache *)malloc(sizeof(VKNVGdeviceCache));
+  if (cache == nullptr)
+    return nullptr;
+  memset(cache, 0, sizeof(VKNVGdeviceCache));
+
+  cache->gpu = gpu;
+  cache->device = device;
+  cache->allocator = allocator;
+  cache->refCount = 1;
+  vknvg_mutexInit(&cache->mutex);
+
+  static const unsigned char fillVertShader[] = {
+#include "shader/fill_vert_shader_hex.txt"
+  };
+
+  static const unsigned char fillFragShader[] = {
+#include "shader/fill_frag_shader_hex.txt"
+  };
+  static const unsigned char stencilFragShader[] = {
+#include "shader/stencil_frag_shader_hex.txt"
+  };
+  static const unsigned char textVertShader[] = {
+#include "shader/text_vert_shader_hex.txt"
+  };
+
+  cache->fillVertShader = vknvg_createShaderModule(device, fillVertShader, sizeof(fillVertShader), allocator);
+  cache->fillFragShader = vknvg_createShaderModule(device, fillFragShader, sizeof(fillFragShader), allocator);
+  cache->stencilFragShader = vknvg_createShaderModule(device, stencilFragShader, sizeof(stencilFragShader), allocator);
+  cache->textVertShader = vknvg_createShaderModule(device, textVertShader, sizeof(textVertShader), allocator);
+
+  cache->descLayout = vknvg_createDescriptorSetLayout(device, allocator);
+  cache->pipelineLayout = vknvg_createPipelineLayout(device, 1, &cache->descLayout, allocator);
+  cache->stencilDescLayout = vknvg_createStencilDescriptorSetLayout(device, allocator);
+  cache->stencilPipelineLayout = vknvg_createPipelineLayout(device, 1, &cache->stencilDescLayout, allocator);
+
+  for (int i = 0; i < VKNVG_SAMPLER_COUNT; i++) {
+    cache->samplers[i] = vknvg_createSampler(device, i, allocator);
+  }
+  return cache;
+}
+void nvgVkDeleteDeviceCache(VKNVGdeviceCache *cache) {
+  if (cache) {
+    vknvg_releaseDeviceCache(cache);
+  }
+}
+
+VKNVGframebuffer *nvgVkCreateFramebuffer(NVGcontext *ctx, int w, int h, int imageFlags) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+  const VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+  VkImageAspectFlags stencilAspect = VK_IMAGE_ASPECT_STENCIL_BIT;
+  VkImageView attachments[2];
+  VkFramebufferCreateInfo fb_info = {VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+
+  VkFormat stencilFormat = vknvg_findStencilFormat(vk->createInfo.gpu, (vk->flags & NVG_DEPTH_OVERDRAW) != 0);
+  if (stencilFormat == VK_FORMAT_UNDEFINED)
+    return nullptr;
+
+  VKNVGframebuffer *fb = (VKNVGframebuffer *)malloc(sizeof(VKNVGframebuffer));
+  if (fb == nullptr)
+    return nullptr;
+  memset(fb, 0, sizeof(VKNVGframebuffer));
+
+  VKNVGtexture *tex = vknvg_allocTexture(vk);
+  if (tex == nullptr) {
+    free(fb);
+    return nullptr;
+  }
+
+  VkImageCreateInfo image_createInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  image_createInfo.imageType = VK_IMAGE_TYPE_2D;
+  image_createInfo.format = colorFormat;
+  image_createInfo.extent.width = w;
+  image_createInfo.extent.height = h;
+  image_createInfo.extent.depth = 1;
+  image_createInfo.mipLevels = 1;
+  image_createInfo.arrayLayers = 1;
+  image_createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_createInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vknvg_createImage(vk, &image_createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tex->image, &tex->mem) != VK_SUCCESS)
+    goto error;
+
+  image_createInfo.format = stencilFormat;
+  image_createInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if (vknvg_createImage(vk, &image_createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &fb->stencilImage, &fb->stencilMem) != VK_SUCCESS)
+    goto error;
+
+  if (stencilFormat != VK_FORMAT_S8_UINT) {
+    stencilAspect |= VK_IMAGE_ASPECT_DEPTH_BIT;
+  }
+  tex->view = vknvg_createImageView(device, tex->image, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, allocator);
+  fb->stencilView = vknvg_createImageView(device, fb->stencilImage, stencilFormat, stencilAspect, allocator);
+  if (tex->view == VK_NULL_HANDLE || fb->stencilView == VK_NULL_HANDLE)
+    goto error;
+
+  tex->sampler = vknvg_getSampler(vk->cache, imageFlags);
+  tex->width = w;
+  tex->height = h;
+  tex->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  tex->type = NVG_TEXTURE_RGBA;
+  tex->flags = imageFlags | NVG_IMAGE_PREMULTIPLIED;
+  tex->mappable = false;
+
+  fb->renderpass = vknvg_getFramebufferRenderPass(vk->cache, colorFormat, stencilFormat);
+  if (fb->renderpass == VK_NULL_HANDLE)
+    goto error;
+
+  attachments[0] = tex->view;
+  attachments[1] = fb->stencilView;
+  fb_info.renderPass = fb->renderpass;
+  fb_info.attachmentCount = 2;
+  fb_info.pAttachments = attachments;
+  fb_info.width = w;
+  fb_info.height = h;
+  fb_info.layers = 1;
+  if (vkCreateFramebuffer(device, &fb_info, allocator, &fb->framebuffer) != VK_SUCCESS)
+    goto error;
+
+  if (vk->createInfo.queue != VK_NULL_HANDLE) {
+    // transparent black and in the layout it is sampled with, until the first pass renders it
+    VkClearColorValue clear = {{0.0f, 0.0f, 0.0f, 0.0f}};
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkCommandBuffer cmdBuffer = vknvg_beginUpload(vk);
+    vknvg_imageBarrier(cmdBuffer, tex->image, 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    vkCmdClearColorImage(cmdBuffer, tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear, 1, &range);
+    vknvg_imageBarrier(cmdBuffer, tex->image, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    vknvg_submitUpload(vk, cmdBuffer);
+  }
+
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    vknvg_writeTextureDescriptor(vk, vknvg_textureIndex(tex), tex);
+  }
+  fb->ctx = ctx;
+  fb->image = tex->id;
+  fb->width = w;
+  fb->height = h;
+  return fb;
+
+error:
+  // nothing has used any of it yet, the render pass belongs to the cache
+  if (fb->stencilView != VK_NULL_HANDLE)
+    vkDestroyImageView(device, fb->stencilView, allocator);
+  if (fb->stencilImage != VK_NULL_HANDLE)
+    vkDestroyImage(device, fb->stencilImage, allocator);
+  if (fb->stencilMem != VK_NULL_HANDLE)
+    vkFreeMemory(device, fb->stencilMem, allocator);
+  vknvg_deleteTexture(vk, tex);
+  free(fb);
+  return nullptr;
+}
+
+void nvgVkBindFramebuffer(NVGcontext *ctx, VKNVGframebuffer *fb) {
+  NVGparams *params = nvgInternalParams(ctx);
+  VKNVGcontext *vk = (VKNVGcontext *)params->userPtr;
+  VkCommandBuffer cmdBuffer = vk->createInfo.cmdBuffer;
+
+  if (vk->boundFramebuffer) {
+    vkCmdEndRenderPass(cmdBuffer);
+    vk->boundFramebuffer = nullptr;
+  }
+  // framebuffers are single sampled, they need the fringes a multisampled createInfo.renderpass goes without
+  bool antialias = vk->antialias && (fb != nullptr || vk->createInfo.sampleCount == VK_SAMPLE_COUNT_1_BIT);
+  vk->flags = antialias ? vk->flags | NVG_ANTIALIAS : vk->flags & ~NVG_ANTIALIAS;
+  params->edgeAntiAlias = antialias ? 1 : 0;
+  vk->renderpass = vk->createInfo.renderpass;
+  if (fb == nullptr) {
+    return;
+  }
+
+  VkClearValue clear_values[2];
+  memset(clear_values, 0, sizeof(clear_values));
+  clear_values[1].depthStencil.depth = 1.0f;
+
+  VkRenderPassBeginInfo rp_begin = {VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  rp_begin.renderPass = fb->renderpass;
+  rp_begin.framebuffer = fb->framebuffer;
+  rp_begin.renderArea.extent.width = fb->width;
+  rp_begin.renderArea.extent.height = fb->height;
+  rp_begin.clearValueCount = 2;
+  rp_begin.pClearValues = clear_values;
+  vkCmdBeginRenderPass(cmdBuffer, &rp_begin, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = {0};
+  viewport.width = (float)fb->width;
+  viewport.height = (float)fb->height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(cmdBuffer, 0, 1, &rp_begin.renderArea);
+
+  vk->renderpass = fb->renderpass;
+  vk->boundFramebuffer = fb;
+}
+
+void nvgVkDeleteFramebuffer(VKNVGframebuffer *fb) {
+  if (fb == nullptr)
+    return;
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(fb->ctx)->userPtr;
+
+  if (vk->boundFramebuffer == fb) {
+    nvgVkBindFramebuffer(fb->ctx, nullptr);
+  }
+  VKNVGgarbage g = {0};
+  g.framebuffer = fb->framebuffer;
+  g.view = fb->stencilView;
+  g.image = fb->stencilImage;
+  g.mem = fb->stencilMem;
+  vknvg_release(vk, g);
+  if (fb->image != 0) {
+    nvgDeleteImage(fb->ctx, fb->image);
+  }
+  free(fb);
+}
+
+void nvgVkBeginDisplayList(NVGcontext *ctx) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  vk->capturing = true;
+  vk->captureCall = vk->calls.count;
+  vk->capturePath = vk->paths.count;
+  vk->captureVert = vk->verts.count;
+  vk->captureUniform = vk->uniforms.count;
+  vk->captureGlyph = vk->glyphs.count;
+}
+
+VKNVGdisplayList *nvgVkEndDisplayList(NVGcontext *ctx) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  if (!vk->capturing)
+    return nullptr;
+  vk->capturing = false;
+
+  VKNVGdisplayList *list = (VKNVGdisplayList *)malloc(sizeof(VKNVGdisplayList));
+  if (list == nullptr)
+    goto error;
+  memset(list, 0, sizeof(VKNVGdisplayList));
+
+  list->ncalls = vk->calls.count - vk->captureCall;
+  list->npaths = vk->paths.count - vk->capturePath;
+  list->calls = (VKNVGcall *)malloc(sizeof(VKNVGcall) * vknvg_maxi(list->ncalls, 1));
+  list->paths = (VKNVGpath *)malloc(sizeof(VKNVGpath) * vknvg_maxi(list->npaths, 1));
+  if (list->calls == nullptr || list->paths == nullptr) {
+    free(list->calls);
+    free(list->paths);
+    free(list);
+    list = nullptr;
+    goto error;
+  }
+
+  // Rebase the offsets onto the list's own buffers.
+  {
+    int vertBase = vk->captureVert;
+    int uniformBase = vk->captureUniform * vk->fragSize;
+    vknvg_arenaCopy(&vk->calls, list->calls, vk->captureCall, list->ncalls);
+    vknvg_arenaCopy(&vk->paths, list->paths, vk->capturePath, list->npaths);
+    vknvg_boundsInit(list->bounds);
+    for (int i = 0; i < list->ncalls; i++) {
+      VKNVGcall *call = &list->calls[i];
+      list->bounds[0] = call->bounds[0] < list->bounds[0] ? call->bounds[0] : list->bounds[0];
+      list->bounds[1] = call->bounds[1] < list->bounds[1] ? call->bounds[1] : list->bounds[1];
+      list->bounds[2] = call->bounds[2] > list->bounds[2] ? call->bounds[2] : list->bounds[2];
+      list->bounds[3] = call->bounds[3] > list->bounds[3] ? call->bounds[3] : list->bounds[3];
+      call->pathOffset -= vk->capturePath;
+      if (call->triangleCount > 0)
+        call->triangleOffset -= vertBase;
+      if (call->glyphCount > 0)
+        call->glyphOffset -= vk->captureGlyph;
+      call->uniformOffset -= uniformBase;
+    }
+    for (int i = 0; i < list->npaths; i++) {
+      VKNVGpath *path = &list->paths[i];
+      if (path->fillCount > 0)
+        path->fillOffset -= vertBase;
+      if (path->strokeCount > 0)
+        path->strokeOffset -= vertBase;
+    }
+
+    int nverts = vk->verts.count - vk->captureVert;
+    int nuniforms = vk->uniforms.count - vk->captureUniform;
+    int nglyphs = vk->glyphs.count - vk->captureGlyph;
+    VkResult res = VK_SUCCESS;
+    if (nverts > 0) {
+      const VKNVGarena *verts = (vk->flags & NVG_PACKED_VERTICES) ? &vk->packedVerts : &vk->verts;
+      res = vknvg_createStaticArenaBuffer(vk, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, verts, vk->captureVert, nverts, &list->vertexBuffer);
+    }
+    if (res == VK_SUCCESS && nuniforms > 0) {
+      res = vknvg_createStaticArenaBuffer(vk, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, &vk->uniforms, vk->captureUniform, nuniforms, &list->fragUniformBuffer);
+    }
+    if (res == VK_SUCCESS && nglyphs > 0) {
+      res = vknvg_createStaticArenaBuffer(vk, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vk->glyphs, vk->captureGlyph, nglyphs, &list->glyphBuffer);
+    }
+    if (res != VK_SUCCESS) {
+      // no frame has used the buffers that were made
+      VkDevice device = vk->createInfo.device;
+      const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+      vknvg_destroyBuffer(device, allocator, &list->vertexBuffer);
+      vknvg_destroyBuffer(device, allocator, &list->fragUniformBuffer);
+      vknvg_destroyBuffer(device, allocator, &list->glyphBuffer);
+      free(list->calls);
+      free(list->paths);
+      free(list);
+      list = nullptr;
+    }
+  }
+
+error:
+  // The captured calls are not part of the frame.
+  vknvg_arenaRewind(&vk->calls, vk->captureCall);
+  vknvg_arenaRewind(&vk->paths, vk->capturePath);
+  vknvg_arenaRewind(&vk->verts, vk->captureVert);
+  if (vk->flags & NVG_PACKED_VERTICES) {
+    vknvg_arenaRewind(&vk->packedVerts, vk->captureVert);
+  }
+  vknvg_arenaRewind(&vk->uniforms, vk->captureUniform);
+  vknvg_arenaRewind(&vk->glyphs, vk->captureGlyph);
+  return list;
+}
+
+size_t nvgVkFrameMemoryHighWater(NVGcontext *ctx) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  const VKNVGarena *arenas[7] = {&vk->calls, &vk->paths, &vk->verts, &vk->packedVerts, &vk->uniforms, &vk->coverage, &vk->glyphs};
+  size_t size = 0;
+  for (int i = 0; i < 7; i++) {
+    size += (size_t)vknvg_maxi(arenas[i]->highWater, arenas[i]->count) * arenas[i]->elemSize;
+  }
+  return size;
+}
+
+int nvgVkCreateImageSDF(NVGcontext *ctx, int w, int h, int imageFlags, float range, const unsigned char *data) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  int type = NVG_TEXTURE_RGBA;
+  if (!(imageFlags & NVG_IMAGE_MSDF)) {
+    imageFlags |= NVG_IMAGE_SDF;
+    type = NVG_TEXTURE_ALPHA;
+  }
+  int image = vknvg_renderCreateTexture(vk, type, w, h, imageFlags, data);
+  VKNVGtexture *tex = vknvg_findTexture(vk, image);
+  if (tex) {
+    tex->sdfRange = range;
+  }
+  return image;
+}
+
+int nvgVkCreateImageCompressed(NVGcontext *ctx, VkFormat format, int w, int h, int mipLevels, int imageFlags,
+                               const void *const *levels, const size_t *sizes) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+
+  // compressed formats are rarely sampleable with linear tiling, so there is no host visible fallback
+  if (vk->createInfo.queue == VK_NULL_HANDLE || mipLevels < 1 || mipLevels > 32)
+    return 0;
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(vk->createInfo.gpu, format, &props);
+  VkFormatFeatureFlags features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+  if ((props.optimalTilingFeatures & features) != features)
+    return 0;
+
+  VKNVGtexture *tex = vknvg_allocTexture(vk);
+  if (tex == nullptr)
+    return 0;
+
+  VkImageCreateInfo image_createInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  image_createInfo.imageType = VK_IMAGE_TYPE_2D;
+  image_createInfo.format = format;
+  image_createInfo.extent.width = w;
+  image_createInfo.extent.height = h;
+  image_createInfo.extent.depth = 1;
+  image_createInfo.mipLevels = mipLevels;
+  image_createInfo.arrayLayers = 1;
+  image_createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_createInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  image_createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vknvg_createImage(vk, &image_createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tex->image, &tex->mem) != VK_SUCCESS) {
+    vknvg_deleteTexture(vk, tex);
+    return 0;
+  }
+  VkMemoryRequirements mem_reqs;
+  vkGetImageMemoryRequirements(device, tex->image, &mem_reqs);
+  tex->memSize = mem_reqs.size;
+  vk->textureMemory += mem_reqs.size;
+
+  // Levels go back to back into one staging buffer, at offsets aligned for any block size.
+  VkBufferImageCopy regions[32];
+  VkDeviceSize size = 0;
+  for (int i = 0; i < mipLevels; i++) {
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = size;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = i;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = vknvg_maxi(w >> i, 1);
+    region.imageExtent.height = vknvg_maxi(h >> i, 1);
+    region.imageExtent.depth = 1;
+    regions[i] = region;
+    size += ((VkDeviceSize)sizes[i] + 15) & ~(VkDeviceSize)15;
+  }
+  VKNVGBuffer staging;
+  if (vknvg_tryCreateBuffer(device, vk->memoryProperties, allocator, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, nullptr, size, &staging) != VK_SUCCESS) {
+    vknvg_deleteTexture(vk, tex);
+    return 0;
+  }
+  unsigned char *mapped;
+  if (vkMapMemory(device, staging.mem, 0, size, 0, (void **)&mapped) != VK_SUCCESS) {
+    vknvg_destroyBuffer(device, allocator, &staging);
+    vknvg_deleteTexture(vk, tex);
+    return 0;
+  }
+  for (int i = 0; i < mipLevels; i++) {
+    memcpy(mapped + regions[i].bufferOffset, levels[i], sizes[i]);
+  }
+  vkUnmapMemory(device, staging.mem);
+
+  VkCommandBuffer cmdBuffer = vknvg_beginUpload(vk);
+  vknvg_imageBarrier(cmdBuffer, tex->image, mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+  vkCmdCopyBufferToImage(cmdBuffer, staging.buffer, tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions);
+  vknvg_imageBarrier(cmdBuffer, tex->image, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                     VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  vknvg_endUpload(vk, cmdBuffer);
+  vknvg_destroyBuffer(device, allocator, &staging);
+
+  tex->type = (format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_EAC_R11_UNORM_BLOCK) ? NVG_TEXTURE_ALPHA : NVG_TEXTURE_RGBA;
+  VkImageViewCreateInfo view_info = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  view_info.image = tex->image;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.components = vknvg_textureSwizzle(tex->type);
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.levelCount = mipLevels;
+  view_info.subresourceRange.layerCount = 1;
+  if (vkCreateImageView(device, &view_info, allocator, &tex->view) != VK_SUCCESS) {
+    tex->view = VK_NULL_HANDLE;
+    vknvg_deleteTexture(vk, tex);
+    return 0;
+  }
+
+  if (mipLevels > 1) {
+    imageFlags |= NVG_IMAGE_GENERATE_MIPMAPS;
+  } else {
+    imageFlags &= ~NVG_IMAGE_GENERATE_MIPMAPS;
+  }
+  tex->sampler = vknvg_getSampler(vk->cache, imageFlags);
+  tex->width = w;
+  tex->height = h;
+  tex->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  tex->flags = imageFlags;
+  tex->sdfRange = VKNVG_DEFAULT_SDF_RANGE;
+  tex->mappable = false;
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    vknvg_writeTextureDescriptor(vk, vknvg_textureIndex(tex), tex);
+  }
+  return tex->id;
+}
+
+int nvgVkCreateImageFromHostMemory(NVGcontext *ctx, int w, int h, int imageFlags, void *data, VkDeviceSize size) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  VkDevice device = vk->createInfo.device;
+  const VkAllocationCallbacks *allocator = vk->createInfo.allocator;
+
+  PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties =
+      (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT");
+  if (getMemoryHostPointerProperties == nullptr)
+    return 0;
+  VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProps = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT};
+  VkPhysicalDeviceProperties2 props = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+  props.pNext = &hostProps;
+  vkGetPhysicalDeviceProperties2(vk->createInfo.gpu, &props);
+  VkDeviceSize align = hostProps.minImportedHostPointerAlignment;
+  if (align == 0 || (uintptr_t)data % align != 0 || size % align != 0 || size < (VkDeviceSize)w * h * 4)
+    return 0;
+  VkMemoryHostPointerPropertiesEXT pointerProps = {VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+  if (getMemoryHostPointerProperties(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, data, &pointerProps) != VK_SUCCESS)
+    return 0;
+
+  bool linear = vknvg_hostImageImportable(vk, VK_IMAGE_TILING_LINEAR, VK_IMAGE_USAGE_SAMPLED_BIT, w, h);
+  bool staging = vk->createInfo.queue != VK_NULL_HANDLE && vknvg_hostBufferImportable(vk, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  if (!linear && !staging)
+    return 0;
+
+  VKNVGtexture *tex = vknvg_allocTexture(vk);
+  if (tex == nullptr)
+    return 0;
+
+  // Linear image bound to the memory itself, if its rows are laid out like the caller's.
+  VkExternalMemoryImageCreateInfo external_image = {VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO};
+  external_image.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  VkImageCreateInfo image_createInfo = {VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  image_createInfo.pNext = &external_image;
+  image_createInfo.imageType = VK_IMAGE_TYPE_2D;
+  image_createInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  image_createInfo.extent.width = w;
+  image_createInfo.extent.height = h;
+  image_createInfo.extent.depth = 1;
+  image_createInfo.mipLevels = 1;
+  image_createInfo.arrayLayers = 1;
+  image_createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_createInfo.tiling = VK_IMAGE_TILING_LINEAR;
+  image_createInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+  image_createInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+  image_createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  bool direct = false;
+  if (linear && vkCreateImage(device, &image_createInfo, allocator, &tex->image) != VK_SUCCESS) {
+    tex->image = VK_NULL_HANDLE;
+  } else if (linear) {
+    VkMemoryRequirements mem_reqs;
+    vkGetImageMemoryRequirements(device, tex->image, &mem_reqs);
+    VkImageSubresource subres = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0};
+    VkSubresourceLayout layout;
+    vkGetImageSubresourceLayout(device, tex->image, &subres, &layout);
+    direct = layout.offset == 0 && layout.rowPitch == (VkDeviceSize)w * 4 && mem_reqs.size <= size &&
+             vknvg_importHostMemory(vk, data, size, mem_reqs.memoryTypeBits & pointerProps.memoryTypeBits, &tex->mem) == VK_SUCCESS &&
+             vkBindImageMemory(device, tex->image, tex->mem, 0) == VK_SUCCESS;
+    if (!direct) {
+      // the staging path below, if it is supported
+      vkDestroyImage(device, tex->image, allocator);
+      tex->image = VK_NULL_HANDLE;
+      if (tex->mem != VK_NULL_HANDLE) {
+        vkFreeMemory(device, tex->mem, allocator);
+        tex->mem = VK_NULL_HANDLE;
+      }
+    }
+  }
+  if (!direct) {
+    if (!staging) {
+      vknvg_deleteTexture(vk, tex);
+      return 0;
+    }
+
+    // Staging buffer on the memory, copied into an optimal image.
+    VkExternalMemoryBufferCreateInfo external_buffer = {VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO};
+    external_buffer.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    VkBufferCreateInfo buf_createInfo = {VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buf_createInfo.pNext = &external_buffer;
+    buf_createInfo.size = size;
+    buf_createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    if (vkCreateBuffer(device, &buf_createInfo, allocator, &tex->hostBuffer) != VK_SUCCESS) {
+      tex->hostBuffer = VK_NULL_HANDLE;
+      vknvg_deleteTexture(vk, tex);
+      return 0;
+    }
+    VkMemoryRequirements buf_reqs;
+    vkGetBufferMemoryRequirements(device, tex->hostBuffer, &buf_reqs);
+    if (vknvg_importHostMemory(vk, data, size, buf_reqs.memoryTypeBits & pointerProps.memoryTypeBits, &tex->hostMem) != VK_SUCCESS ||
+        vkBindBufferMemory(device, tex->hostBuffer, tex->hostMem, 0) != VK_SUCCESS) {
+      vknvg_deleteTexture(vk, tex);
+      return 0;
+    }
+
+    image_createInfo.pNext = nullptr;
+    image_createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_createInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (vknvg_createImage(vk, &image_createInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tex->image, &tex->mem) != VK_SUCCESS) {
+      vknvg_deleteTexture(vk, tex);
+      return 0;
+    }
+    VkMemoryRequirements mem_reqs;
+    vkGetImageMemoryRequirements(device, tex->image, &mem_reqs);
+    tex->memSize = mem_reqs.size;
+    vk->textureMemory += mem_reqs.size;
+  }
+  tex->view = vknvg_createImageView(device, tex->image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, allocator);
+  if (tex->view == VK_NULL_HANDLE) {
+    vknvg_deleteTexture(vk, tex);
+    return 0;
+  }
+
+  tex->sampler = vknvg_getSampler(vk->cache, imageFlags);
+  tex->width = w;
+  tex->height = h;
+  tex->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  tex->type = NVG_TEXTURE_RGBA;
+  tex->flags = imageFlags;
+  tex->sdfRange = VKNVG_DEFAULT_SDF_RANGE;
+  tex->mappable = false;
+  tex->hostPointer = data;
+  if (tex->hostBuffer != VK_NULL_HANDLE) {
+    vknvg_copyHostBuffer(vk, tex, true);
+  }
+  if (vk->flags & NVG_BINDLESS_TEXTURES) {
+    vknvg_writeTextureDescriptor(vk, vknvg_textureIndex(tex), tex);
+  }
+  return tex->id;
+}
+
+void nvgVkSetTextureBudget(NVGcontext *ctx, VkDeviceSize budget, VKNVGrestoreImageFn restore, void *userData) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  vk->textureBudget = budget;
+  vk->restoreImage = restore;
+  vk->restoreUserData = userData;
+}
+
+void nvgVkDrawDisplayList(NVGcontext *ctx, VKNVGdisplayList *list, const float *xform, float alpha) {
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+  // lists cannot be nested
+  if (list == nullptr || list->ncalls == 0 || vk->capturing)
+    return;
+
+  float t[6];
+  if (xform) {
+    memcpy(t, xform, sizeof(t));
+  } else {
+    nvgTransformIdentity(t);
+  }
+
+  // Cull with the transformed corners of the list's bounds.
+  float bounds[4];
+  NVGvertex corners[4];
+  vknvg_vset(&corners[0], list->bounds[0], list->bounds[1], 0.0f, 0.0f);
+  vknvg_vset(&corners[1], list->bounds[2], list->bounds[1], 0.0f, 0.0f);
+  vknvg_vset(&corners[2], list->bounds[0], list->bounds[3], 0.0f, 0.0f);
+  vknvg_vset(&corners[3], list->bounds[2], list->bounds[3], 0.0f, 0.0f);
+  for (int i = 0; i < 4; i++) {
+    nvgTransformPoint(&corners[i].x, &corners[i].y, t, corners[i].x, corners[i].y);
+  }
+  vknvg_boundsInit(bounds);
+  vknvg_boundsAdd(bounds, corners, 4);
+  if (!vknvg_boundsVisible(vk, bounds, false, nullptr))
+    return;
+
+  if (vk->restoreImage != nullptr) {
+    // the list's images have to be resident while it is drawn
+    for (int i = 0; i < list->ncalls; i++) {
+      VKNVGtexture *tex = list->calls[i].image != 0 ? vknvg_findTexture(vk, list->calls[i].image) : nullptr;
+      if (tex && !vknvg_useTexture(vk, tex))
+        return;
+    }
+  }
+
+  VKNVGcall *call = vknvg_allocCall(vk);
+  if (call == nullptr)
+    return;
+  call->type = VKNVG_DISPLAYLIST;
+  call->displayList = list;
+  memcpy(call->xform, t, sizeof(call->xform));
+  memcpy(call->bounds, bounds, sizeof(call->bounds));
+  call->alpha = alpha;
+}
+
+void nvgVkDeleteDisplayList(NVGcontext *ctx, VKNVGdisplayList *list) {
+  if (list == nullptr)
+    return;
+  VKNVGcontext *vk = (VKNVGcontext *)nvgInternalParams(ctx)->userPtr;
+
+  vknvg_releaseBuffer(vk, &list->vertexBuffer);
+  vknvg_releaseBuffer(vk, &list->fragUniformBuffer);
+  vknvg_releaseBuffer(vk, &list->glyphBuffer);
+  free(list->calls);
+  free(list->paths);
+  free(list);
+}
+
 #if !defined(__cplusplus) || defined(NANOVG_VK_NO_nullptrPTR)
 #undef nullptr
 #endif
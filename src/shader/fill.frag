@@ -1,6 +1,15 @@
-#version 400
+#version 430
 #extension GL_ARB_separate_shader_objects  : enable
 #extension GL_ARB_shading_language_420pack : enable
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
+// Specialized per pipeline, so each variant is compiled without the branches it does not take.
+layout(constant_id = 0) const int SHADER_TYPE = 0; // enum VKNVGshaderType
+layout(constant_id = 1) const int TEX_TYPE = 0;    // 0: premultiplied (alpha images broadcast R), 1: rgba, 2: sdf, 3: msdf
+layout(constant_id = 2) const bool EDGE_AA = false;
+layout(constant_id = 3) const bool COVERAGE = false; // NVG_COVERAGE_FILLS
 
 layout(std140,binding = 1) uniform frag {
 		mat3 scissorMat;
@@ -16,10 +25,31 @@ layout(std140,binding = 1) uniform frag {
 		float strokeThr;
 		int texType;
 		int type;
+		vec4 coverage; // first band record, band count, top and height of the bands in pixels
+		int texIndex;   // BINDLESS
+		float sdfRange; // texels from distance 0 to 1 of an sdf/msdf image
 	};
+#ifdef BINDLESS
+// NVG_BINDLESS_TEXTURES (fill_bindless_frag_shader_hex.txt): the image is picked from the texture array (set 1) by
+// texIndex, which is the same for the whole draw, so no nonuniformEXT is needed
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+#define tex textures[texIndex]
+#else
 layout(binding = 2)uniform sampler2D tex;
+#endif
+// band records (first edge, edge count) followed by the edges (x0,y0,x1,y1) in pixels of the render target, the
+// viewport offset included, as gl_FragCoord
+layout(std430, binding = 3) readonly buffer coverageData {
+		vec4 records[];
+	};
+layout(push_constant) uniform pushConstants {
+		vec4 xform;
+		vec2 translate;
+		float alpha;
+	};
 layout(location = 0) in vec2 ftcoord;
 layout(location = 1) in vec2 fpos;
+layout(location = 2) flat in vec4 fcolor; // NVG_INSTANCED_TEXT: color of the glyph, 1 otherwise
 layout(location = 0) out vec4 outColor;
 
 float sdroundrect(vec2 pt, vec2 ext, float rad) {
@@ -39,46 +69,67 @@ float strokeMask() {
 	return min(1.0, (1.0-abs(ftcoord.x*2.0-1.0))*strokeMult) * min(1.0, ftcoord.y);
 }
 
-void mainAA(void) {
-   vec4 result;
-	float scissor = scissorMask(fpos);
-	float strokeAlpha = strokeMask();
-	if (strokeAlpha < strokeThr) discard;
-	if (type == 0) {			// Gradient
-		// Calculate gradient color using box gradient
-		vec2 pt = (paintMat * vec3(fpos,1.0)).xy;
-		float d = clamp((sdroundrect(pt, extent, radius) + feather*0.5) / feather, 0.0, 1.0);
-		vec4 color = mix(innerCol,outerCol,d);
-		// Combine alpha
-		color *= strokeAlpha * scissor;
-		result = color;
-	} else if (type == 1) {		// Image
-		// Calculate color fron texture
-		vec2 pt = (paintMat * vec3(fpos,1.0)).xy / extent;
-		vec4 color = texture(tex, pt);
-		if (texType == 1) color = vec4(color.xyz*color.w,color.w);
-		if (texType == 2) color = vec4(color.x);
-		// Apply color tint and alpha.
-		color *= innerCol;
-		// Combine alpha
-		color *= strokeAlpha * scissor;
-		result = color;
-	} else if (type == 2) {		// Stencil fill
-		result = vec4(1,1,1,1);
-	} else if (type == 3) {		// Textured tris
-		vec4 color = texture(tex, ftcoord);
-		if (texType == 1) color = vec4(color.xyz*color.w,color.w);
-		if (texType == 2) color = vec4(color.x);
-		color *= scissor;
-		result = color * innerCol;
+// Integral of clamp(t,0,1) from 0 to t.
+float clampedIntegral(float t) {
+	return t <= 0.0 ? 0.0 : (t < 1.0 ? 0.5*t*t : t - 0.5);
+}
+
+// Exact area of the pixel covered by the path, nonzero winding. Each edge in the pixel's band adds the part of the
+// row it crosses, times how much of the pixel lies to the right of it, signed by its direction.
+float pathCoverage() {
+	vec2 px = floor(gl_FragCoord.xy);
+	float band = clamp(floor((px.y - coverage.z) / coverage.w), 0.0, coverage.y - 1.0);
+	vec4 rec = records[int(coverage.x + band)];
+	int first = int(rec.x);
+	int count = int(rec.y);
+	float area = 0.0;
+	for (int i = 0; i < count; i++) {
+		vec4 e = records[first + i];
+		float y0 = clamp(e.y, px.y, px.y + 1.0);
+		float y1 = clamp(e.w, px.y, px.y + 1.0);
+		if (y0 == y1) continue;
+		float dxdy = (e.z - e.x) / (e.w - e.y);
+		float t0 = px.x + 1.0 - (e.x + (y0 - e.y) * dxdy);
+		float t1 = px.x + 1.0 - (e.x + (y1 - e.y) * dxdy);
+		float mean = abs(t1 - t0) < 1e-4 ? clamp(0.5*(t0 + t1), 0.0, 1.0) : (clampedIntegral(t1) - clampedIntegral(t0)) / (t1 - t0);
+		area += (y1 - y0) * mean;
 	}
-	outColor = result;
+	return min(abs(area), 1.0);
+}
+
+// Coverage of a distance field sample (0.5 on the edge), antialiased over one pixel at any scale.
+float sdfCoverage(float d, vec2 ptWidth) {
+	vec2 texels = ptWidth * vec2(textureSize(tex, 0));
+	float texelsPerPixel = max(0.5 * (texels.x + texels.y), 1e-6);
+	return clamp((d - 0.5) * sdfRange / texelsPerPixel + 0.5, 0.0, 1.0);
+}
+
+// ptWidth: fwidth(pt), only read by distance fields
+vec4 texColor(vec2 pt, vec2 ptWidth) {
+	vec4 color = texture(tex, pt);
+	if (TEX_TYPE == 1) color = vec4(color.xyz*color.w,color.w);
+	if (TEX_TYPE == 2) color = vec4(sdfCoverage(color.x, ptWidth));
+	if (TEX_TYPE == 3) color = vec4(sdfCoverage(max(min(color.r, color.g), min(max(color.r, color.g), color.b)), ptWidth));
+	return color;
 }
+
 void main(void) {
-   vec4 result;
+	vec4 result;
+	// SHADER_TYPE 2 (stencil fill) uses stencil.frag
 	float scissor = scissorMask(fpos);
+	// image coordinates, with their derivatives taken before anything is discarded
+	vec2 uv = SHADER_TYPE == 1 ? (paintMat * vec3(fpos,1.0)).xy / extent : ftcoord;
+	vec2 uvWidth = TEX_TYPE >= 2 ? fwidth(uv) : vec2(0.0);
 	float strokeAlpha = 1.0;
-	if (type == 0) {			// Gradient
+	if (EDGE_AA) {
+		strokeAlpha = strokeMask();
+		if (strokeAlpha < strokeThr) discard;
+	}
+	if (COVERAGE) {
+		strokeAlpha *= pathCoverage();
+		if (strokeAlpha == 0.0) discard;
+	}
+	if (SHADER_TYPE == 0) {			// Gradient
 		// Calculate gradient color using box gradient
 		vec2 pt = (paintMat * vec3(fpos,1.0)).xy;
 		float d = clamp((sdroundrect(pt, extent, radius) + feather*0.5) / feather, 0.0, 1.0);
@@ -86,25 +137,18 @@ void main(void) {
 		// Combine alpha
 		color *= strokeAlpha * scissor;
 		result = color;
-	} else if (type == 1) {		// Image
+	} else if (SHADER_TYPE == 1) {		// Image
 		// Calculate color fron texture
-		vec2 pt = (paintMat * vec3(fpos,1.0)).xy / extent;
-		vec4 color = texture(tex, pt);
-		if (texType == 1) color = vec4(color.xyz*color.w,color.w);
-		if (texType == 2) color = vec4(color.x);
+		vec4 color = texColor(uv, uvWidth);
 		// Apply color tint and alpha.
 		color *= innerCol;
 		// Combine alpha
 		color *= strokeAlpha * scissor;
 		result = color;
-	} else if (type == 2) {		// Stencil fill
-		result = vec4(1,1,1,1);
-	} else if (type == 3) {		// Textured tris
-		vec4 color = texture(tex, ftcoord);
-		if (texType == 1) color = vec4(color.xyz*color.w,color.w);
-		if (texType == 2) color = vec4(color.x);
+	} else {		// Textured tris
+		vec4 color = texColor(uv, uvWidth);
 		color *= scissor;
-		result = color * innerCol;
+		result = color * innerCol * fcolor;
 	}
-	outColor = result;
-}
\ No newline at end of file
+	outColor = result * alpha;
+}
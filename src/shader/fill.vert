@@ -5,13 +5,25 @@
 layout (binding = 0) uniform buffer{
   vec2 viewSize;
 };
+layout (push_constant) uniform pushConstants{
+  vec4 xform;     // replay transform of a display list (a,b,c,d), identity otherwise
+  vec2 translate; // (e,f)
+  float alpha;
+  float depth;     // NVG_DEPTH_OVERDRAW: painter's order of the call, 0 otherwise
+  vec4 posDequant; // NVG_PACKED_VERTICES: position = vertex * posDequant.xy + posDequant.zw, identity otherwise
+  vec4 uvDequant;  // same for tcoord
+};
 
 layout (location = 0) in vec2 vertex;
 layout (location = 1) in vec2 tcoord;
 layout (location = 0) out vec2 ftcoord;
 layout (location = 1) out vec2 fpos;
+layout (location = 2) flat out vec4 fcolor;
 void main(void) {
-	ftcoord = tcoord;
-	fpos = vertex;
-	gl_Position = vec4(2.0*vertex.x/viewSize.x - 1.0, 2.0*vertex.y/viewSize.y - 1.0, 0, 1);
+	vec2 p = vertex * posDequant.xy + posDequant.zw;
+	ftcoord = tcoord * uvDequant.xy + uvDequant.zw;
+	fpos = p;
+	fcolor = vec4(1.0);
+	vec2 pos = mat2(xform.xy, xform.zw) * p + translate;
+	gl_Position = vec4(2.0*pos.x/viewSize.x - 1.0, 2.0*pos.y/viewSize.y - 1.0, depth, 1);
 }
\ No newline at end of file
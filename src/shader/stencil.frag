@@ -0,0 +1,7 @@
+#version 400
+#extension GL_ARB_separate_shader_objects  : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Stencil only passes, coverage is written by the stencil ops alone.
+void main(void) {
+}
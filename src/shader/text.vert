@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects  : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// NVG_INSTANCED_TEXT: one instance per glyph, expanded into a 4 vertex strip. Pairs with fill.frag.
+layout (binding = 0) uniform viewBuffer{
+  vec2 viewSize;
+};
+layout (push_constant) uniform pushConstants{
+  vec4 xform;     // replay transform of a display list (a,b,c,d), identity otherwise
+  vec2 translate; // (e,f)
+  float alpha;
+  float depth;    // NVG_DEPTH_OVERDRAW: painter's order of the call, 0 otherwise
+};
+
+layout (location = 0) in vec4 rect;   // x0,y0,x1,y1
+layout (location = 1) in vec4 uvRect; // s0,t0,s1,t1
+layout (location = 2) in vec4 color;  // premultiplied
+layout (location = 0) out vec2 ftcoord;
+layout (location = 1) out vec2 fpos;
+layout (location = 2) flat out vec4 fcolor;
+void main(void) {
+	// (x0,y0) (x0,y1) (x1,y0) (x1,y1), the winding of nanovg's glyph triangles
+	vec2 corner = vec2(gl_VertexIndex >> 1, gl_VertexIndex & 1);
+	vec2 p = mix(rect.xy, rect.zw, corner);
+	ftcoord = mix(uvRect.xy, uvRect.zw, corner);
+	fpos = p;
+	fcolor = color;
+	vec2 pos = mat2(xform.xy, xform.zw) * p + translate;
+	gl_Position = vec4(2.0*pos.x/viewSize.x - 1.0, 2.0*pos.y/viewSize.y - 1.0, depth, 1);
+}
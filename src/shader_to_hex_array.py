@@ -6,21 +6,27 @@ import sys
 import subprocess
 
 
-if len(sys.argv) != 2:
-  print('Usage: python %s filename' % sys.argv[0])
+# outputname defaults to the file name, defines (-DNAME[=value]) build variants of the same source
+if len(sys.argv) < 2:
+  print('Usage: python %s filename [outputname [-DNAME ...]]' % sys.argv[0])
   quit()
 
 inputfilepath = sys.argv[1];
-outputname = os.path.basename(inputfilepath).replace('.', '_') + '_shader_hex';
+outputname = os.path.basename(inputfilepath).replace('.', '_')
+if len(sys.argv) > 2:
+  outputname = sys.argv[2]
+outputname += '_shader_hex';
+defines = sys.argv[3:]
 outdir = os.path.dirname(inputfilepath)
+spirvpath = os.path.join(outdir, outputname + '.spv')
 
 spirvcompiler = 'glslangValidator'
 if os.name == 'nt':
   spirvcompiler += ".exe"
 
-subprocess.call([spirvcompiler,'-H','-V',inputfilepath,'-o',inputfilepath + '.spv'])
+subprocess.call([spirvcompiler,'-H','-V'] + defines + [inputfilepath,'-o',spirvpath])
 
-infile = open(inputfilepath + '.spv', 'rb')
+infile = open(spirvpath, 'rb')
 outfilepath = os.path.join(outdir,outputname + '.txt')
 outfile = open(outfilepath, 'w')
 